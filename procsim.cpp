@@ -1,25 +1,100 @@
 #include "procsim.hpp"
+#include "procsim_live.hpp"
+#include "procsim_hotspot.hpp"
+#include "procsim_trace.hpp"
+#include "procsim_observer.hpp"
+#include "procsim_debug.hpp"
+#include "procsim_flight.hpp"
+#include "procsim_critical.hpp"
+#include "procsim_occupancy.hpp"
+#include <cinttypes>
+#include <cstdlib>
 #include <vector>
 #include <queue>
 #include <deque>
 #include <algorithm>
 #include <cstring>
+#include <csignal>
+#include <string>
 
 // Global processor state
 uint64_t g_r;    // Number of result buses
-uint64_t g_k0;   // Number of k0 FUs
-uint64_t g_k1;   // Number of k1 FUs
-uint64_t g_k2;   // Number of k2 FUs
 uint64_t g_f;    // Fetch rate
 uint64_t g_rs_size; // Reservation station size
 
+// Function unit classes and the opcode -> class table (indexed by op_code + 1, -1 = unmapped)
+uint64_t g_num_fu_classes;
+fu_class_t g_fu_classes[MAX_FU_CLASSES];
+int32_t g_opcode_class[MAX_OPCODE + 2];
+
+// Engine options (set before setup_proc)
+bool g_print_events = true;    // Print pipeline events to stdout
+bool g_print_progress = true;  // Print periodic progress to stderr
+uint64_t g_max_insts = 0;      // Stop fetching after this many instructions (0 = no limit)
+live_stats_t* g_live = NULL;   // Shared-memory counters for procsim-top (NULL = off)
+const char* g_checkpoint_path = DEFAULT_CHECKPOINT_PATH; // Written on SIGUSR2
+uint64_t g_bypass_paths = 0;   // Operands that can be forwarded per cycle (0 = no bypass network)
+uint64_t g_dispatch_width = 0; // Instructions moved from fetch buffer to DQ per cycle (0 = whole buffer)
+uint64_t g_schedule_width = 0; // Instructions moved from DQ to RS per cycle (0 = no limit)
+uint64_t g_num_clusters = 1;   // Back-end clusters sharing the RS and FU pools
+steer_policy_t g_steer_policy = STEER_ROUND_ROBIN; // How scheduled instructions pick a cluster
+uint64_t g_xcluster_delay = 1; // Extra wakeup cycles for operands produced in another cluster
+uint64_t g_sched_policy = 0;   // Index into sched_policies
+region_t g_regions[MAX_REGIONS];
+uint64_t g_num_regions = 0;
+uint64_t g_watchdog_cycles = 0; // Give up after this many cycles without a retirement (0 = never)
+uint64_t g_first_tag = 1;       // Tag of the first instruction; tests start just below the compact tag wrap
+
+const char* const g_event_names[NUM_PIPELINE_EVENTS] = { "FETCHED", "DISPATCHED", "SCHEDULED", "EXECUTED", "STATE UPDATE" };
+
+// Set by signal handlers, serviced by run_proc at the next cycle boundary
+static volatile sig_atomic_t stats_requested = 0;
+static volatile sig_atomic_t checkpoint_requested = 0;
+
 // Register scoreboard - tracks which instruction will write to each register
-int64_t register_ready[NUM_REGS]; // -1 means ready, otherwise tag of instruction that will write
+ctag_t register_ready[NUM_REGS]; // NO_TAG means ready, otherwise compact tag of instruction that will write
 
-// Function unit availability
-std::vector<bool> fu_k0_available;
-std::vector<bool> fu_k1_available;
-std::vector<bool> fu_k2_available;
+// Function unit availability, per cluster and class
+uint64_t fu_count[MAX_CLUSTERS][MAX_FU_CLASSES];   // Units of each class placed in each cluster
+uint64_t fu_busy[MAX_CLUSTERS][MAX_FU_CLASSES];    // Unpipelined units held from fire until state update
+uint64_t fu_issued[MAX_CLUSTERS][MAX_FU_CLASSES];  // Pipelined units that accepted an instruction this cycle
+
+// Clustered back end: the RS and every FU class are split evenly over g_num_clusters
+uint64_t rs_capacity[MAX_CLUSTERS];  // RS entries per cluster
+uint64_t rs_count[MAX_CLUSTERS];     // RS entries in use per cluster
+uint64_t steer_next = 0;             // Next cluster tried by round-robin steering
+schedule_stop_t last_schedule_stop = SCHEDULE_STOP_END;  // Why the last cycle's DQ scan ended (--critical-path)
+
+// Where each dispatched instruction is, indexed by compact tag & (size - 1). Operand
+// lookups use it instead of searching the RS and DQ. A slot is only reused once its
+// instruction has left the RS; if a live instruction is in the way the table doubles,
+// so it always covers the in-flight window however deep the DQ grows.
+enum tag_location_t
+{
+    TAG_IN_DQ,
+    TAG_IN_RS,
+    TAG_RETIRED       // Left the RS; kept so cross-cluster delays still apply
+};
+
+typedef struct _tag_entry_t
+{
+    ctag_t tag;                  // Owner of the slot, NO_TAG if never used
+    uint8_t location;            // tag_location_t
+    int8_t cluster;
+    bool executed;
+    uint32_t consumers;          // Dispatched instructions reading this result
+    uint64_t complete_cycle;
+    uint64_t state_update_cycle; // 0 until STATE UPDATE
+} tag_entry_t;
+
+#define MIN_TAG_TABLE_SIZE 4096
+std::vector<tag_entry_t> tag_table;
+uint64_t tag_mask = 0;
+
+// Instructions read from g_trace in one batch and not fetched yet
+proc_inst_t fetch_block[TRACE_BATCH];
+size_t fetch_block_len = 0;
+size_t fetch_block_pos = 0;
 
 // Pipeline queues
 std::vector<proc_inst_t> fetch_buffer;    // Pipeline register between fetch and dispatch
@@ -36,6 +111,238 @@ uint64_t total_fired = 0;
 uint64_t total_retired = 0;
 uint64_t total_dispatch_size = 0;
 uint64_t max_dispatch_size = 0;
+uint64_t total_bypass_reads = 0;   // Source operands forwarded from an EXECUTED producer
+uint64_t total_regfile_reads = 0;  // Source operands read from the register file
+uint64_t fetch_stall_cycles = 0;     // Fetch could not fill F slots because the fetch buffer was full
+uint64_t dispatch_stall_cycles = 0;  // Instructions left in the fetch buffer after dispatch
+uint64_t schedule_stall_cycles = 0;  // Scheduling stopped at the schedule width with a ready entry left
+uint64_t rs_full_cycles = 0;         // Scheduling stopped because the RS (or, clustered, every cluster with a unit) was full
+uint64_t cluster_rs_occupancy[MAX_CLUSTERS];  // Sum over cycles of RS entries in use
+uint64_t cluster_fu_busy[MAX_CLUSTERS];       // Sum over cycles of FUs in use
+uint64_t cluster_fired[MAX_CLUSTERS];         // Instructions fired per cluster
+uint64_t cluster_remote_wakeups = 0;          // Operands read from a producer in another cluster
+activity_t activity;                          // Per-structure event counts for energy estimates
+
+// Counter values at one point of the run; region stats are differences of two snapshots
+typedef struct _counter_snapshot_t
+{
+    uint64_t cycle;
+    uint64_t fired;
+    uint64_t retired;
+    uint64_t dispatch_size;
+    uint64_t bypass_reads;
+    uint64_t regfile_reads;
+    uint64_t fetch_stalls;
+    uint64_t dispatch_stalls;
+    uint64_t schedule_stalls;
+    uint64_t rs_full;
+} counter_snapshot_t;
+
+enum region_phase_t
+{
+    REGION_PENDING,
+    REGION_ACTIVE,
+    REGION_DONE
+};
+
+typedef struct _region_state_t
+{
+    uint64_t phase;                 // region_phase_t
+    counter_snapshot_t begin;
+    counter_snapshot_t end;
+    uint64_t max_disp_size;
+} region_state_t;
+
+region_state_t region_state[MAX_REGIONS];
+uint64_t epoch_max_dispatch = 0;             // Largest DQ since the last region boundary
+uint64_t next_region_insts = UINT64_MAX;     // Retired count of the next instruction-based boundary
+uint64_t next_region_cycle = UINT64_MAX;     // Cycle of the next cycle-based boundary
+
+static void take_snapshot(counter_snapshot_t* p)
+{
+    p->cycle = current_cycle;
+    p->fired = total_fired;
+    p->retired = total_retired;
+    p->dispatch_size = total_dispatch_size;
+    p->bypass_reads = total_bypass_reads;
+    p->regfile_reads = total_regfile_reads;
+    p->fetch_stalls = fetch_stall_cycles;
+    p->dispatch_stalls = dispatch_stall_cycles;
+    p->schedule_stalls = schedule_stall_cycles;
+    p->rs_full = rs_full_cycles;
+}
+
+/**
+ * Stats for the part of the run between two snapshots.
+ */
+static void fill_stats(proc_stats_t* p_stats, const counter_snapshot_t* b, const counter_snapshot_t* e,
+                       uint64_t max_disp_size)
+{
+    p_stats->cycle_count = e->cycle - b->cycle;
+    p_stats->retired_instruction = e->retired - b->retired;
+
+    double cycles = p_stats->cycle_count ? (double)p_stats->cycle_count : 1.0;
+    p_stats->avg_inst_fired = (double)(e->fired - b->fired) / cycles;
+    p_stats->avg_inst_retired = (double)(e->retired - b->retired) / cycles;
+    p_stats->avg_disp_size = (double)(e->dispatch_size - b->dispatch_size) / cycles;
+    p_stats->max_disp_size = max_disp_size;
+    p_stats->bypass_reads = e->bypass_reads - b->bypass_reads;
+    p_stats->regfile_reads = e->regfile_reads - b->regfile_reads;
+    p_stats->fetch_stall_cycles = e->fetch_stalls - b->fetch_stalls;
+    p_stats->dispatch_stall_cycles = e->dispatch_stalls - b->dispatch_stalls;
+    p_stats->schedule_stall_cycles = e->schedule_stalls - b->schedule_stalls;
+    p_stats->rs_full_cycles = e->rs_full - b->rs_full;
+}
+
+/**
+ * Starts and ends regions whose boundary has been reached, then finds the next boundary.
+ * Called between cycles only when a boundary is due, so regions cost nothing per cycle.
+ */
+static void update_regions(void)
+{
+    counter_snapshot_t now;
+    take_snapshot(&now);
+
+    next_region_insts = UINT64_MAX;
+    next_region_cycle = UINT64_MAX;
+    for (uint64_t i = 0; i < g_num_regions; i++) {
+        const region_t* r = &g_regions[i];
+        region_state_t* st = &region_state[i];
+        uint64_t pos = r->in_cycles ? current_cycle : total_retired;
+
+        if (st->phase == REGION_ACTIVE) {
+            st->max_disp_size = std::max(st->max_disp_size, epoch_max_dispatch);
+        }
+        if (st->phase == REGION_PENDING && pos >= r->start) {
+            st->phase = REGION_ACTIVE;
+            st->begin = now;
+            st->max_disp_size = 0;
+        }
+        if (st->phase == REGION_ACTIVE && r->end != 0 && pos >= r->end) {
+            st->phase = REGION_DONE;
+            st->end = now;
+        }
+
+        uint64_t next = st->phase == REGION_PENDING ? r->start :
+                        st->phase == REGION_ACTIVE && r->end != 0 ? r->end : UINT64_MAX;
+        uint64_t* p_next = r->in_cycles ? &next_region_cycle : &next_region_insts;
+        *p_next = std::min(*p_next, next);
+    }
+    epoch_max_dispatch = 0;
+}
+
+/**
+ * Print a single pipeline event line (CYCLE OPERATION INSTRUCTION).
+ */
+static inline void log_event(int event, uint64_t tag)
+{
+    if (g_print_events) {
+        printf("%" PRIu64 "\t%s\t%" PRIu64 "\n", current_cycle, g_event_names[event], tag);
+        fflush(stdout);
+    }
+    if (g_flight_cycles != 0) {
+        flight_record(current_cycle, event, tag);
+    }
+    if (g_debug) {
+        debug_event(event, tag, current_cycle);
+    }
+}
+
+static inline tag_entry_t* tag_lookup(ctag_t tag)
+{
+    tag_entry_t* e = &tag_table[tag & tag_mask];
+    return e->tag == tag ? e : NULL;
+}
+
+/**
+ * Rebuilds the tag table at twice the size, keeping every entry.
+ */
+static void tag_table_grow(void)
+{
+    std::vector<tag_entry_t> old;
+    old.swap(tag_table);
+
+    tag_table.assign(old.size() * 2, tag_entry_t());
+    tag_mask = tag_table.size() - 1;
+    for (size_t i = 0; i < old.size(); i++) {
+        if (old[i].tag != NO_TAG) {
+            tag_table[old[i].tag & tag_mask] = old[i];
+        }
+    }
+}
+
+/**
+ * Claims the slot for a newly dispatched instruction.
+ */
+static tag_entry_t* tag_insert(ctag_t tag)
+{
+    tag_entry_t* e = &tag_table[tag & tag_mask];
+    while (e->tag != NO_TAG && e->location != TAG_RETIRED) {
+        tag_table_grow();
+        e = &tag_table[tag & tag_mask];
+    }
+
+    memset(e, 0, sizeof(*e));
+    e->tag = tag;
+    e->location = TAG_IN_DQ;
+    return e;
+}
+
+/**
+ * Publish the current counters to the live stats segment under its seqlock.
+ */
+static void publish_live_stats(bool finished)
+{
+    live_write_begin(g_live);
+    g_live->current_cycle.store(current_cycle, std::memory_order_relaxed);
+    g_live->total_retired.store(total_retired, std::memory_order_relaxed);
+    g_live->total_fired.store(total_fired, std::memory_order_relaxed);
+    g_live->dq_size.store(dispatch_queue.size(), std::memory_order_relaxed);
+    g_live->rs_size.store(schedule_queue.size(), std::memory_order_relaxed);
+    g_live->rs_capacity.store(g_rs_size, std::memory_order_relaxed);
+    g_live->num_fu_classes.store(g_num_fu_classes, std::memory_order_relaxed);
+    for (uint64_t i = 0; i < g_num_fu_classes; i++) {
+        uint64_t busy = 0;
+        for (uint64_t c = 0; c < g_num_clusters; c++) {
+            busy += g_fu_classes[i].pipelined ? fu_issued[c][i] : fu_busy[c][i];
+        }
+        g_live->fu_busy[i].store(busy, std::memory_order_relaxed);
+        g_live->fu_count[i].store(g_fu_classes[i].count, std::memory_order_relaxed);
+    }
+    g_live->finished.store(finished, std::memory_order_relaxed);
+    live_write_end(g_live);
+}
+
+static void handle_stats_signal(int)
+{
+    stats_requested = 1;
+}
+
+static void handle_checkpoint_signal(int)
+{
+    checkpoint_requested = 1;
+}
+
+/**
+ * SIGUSR1 prints a statistics snapshot, SIGUSR2 writes a checkpoint to g_checkpoint_path.
+ * The handlers only set flags; run_proc does the work between cycles.
+ */
+void install_proc_signal_handlers(void)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+
+    sa.sa_handler = handle_stats_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = handle_checkpoint_signal;
+    sigaction(SIGUSR2, &sa, NULL);
+
+    if (g_flight_cycles != 0) {
+        install_flight_handlers();
+    }
+}
 
 /**
  * Subroutine for initializing the processor.
@@ -43,45 +350,325 @@ uint64_t max_dispatch_size = 0;
 void setup_proc(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f)
 {
     g_r = r;
-    g_k0 = k0;
-    g_k1 = k1;
-    g_k2 = k2;
     g_f = f;
-    g_rs_size = 2 * (k0 + k1 + k2);
+
+    // Three unpipelined single-cycle classes; opcode -1 runs on class 1
+    fu_class_t classes[3] = { { k0, 1, false }, { k1, 1, false }, { k2, 1, false } };
+    int32_t opcode_class[MAX_OPCODE + 2];
+    for (int i = 0; i < MAX_OPCODE + 2; i++) {
+        opcode_class[i] = -1;
+    }
+    opcode_class[-1 + 1] = 1;
+    for (int i = 0; i < 3; i++) {
+        opcode_class[i + 1] = i;
+    }
+    setup_fu_classes(classes, 3, opcode_class);
 
     // Initialize register scoreboard - all registers are initially ready
     for (int i = 0; i < NUM_REGS; i++) {
-        register_ready[i] = -1;
+        register_ready[i] = NO_TAG;
     }
+    tag_table.assign(MIN_TAG_TABLE_SIZE, tag_entry_t());
+    tag_mask = MIN_TAG_TABLE_SIZE - 1;
 
-    // Initialize function units
-    fu_k0_available.resize(k0, true);
-    fu_k1_available.resize(k1, true);
-    fu_k2_available.resize(k2, true);
-
-    next_tag = 1;
+    next_tag = g_first_tag;
+    fetch_block_len = 0;
+    fetch_block_pos = 0;
+    memset(region_state, 0, sizeof(region_state));
+    if (g_flight_cycles != 0) {
+        flight_reset();
+    }
+    if (g_critical_path) {
+        critical_reset();
+    }
+    occupancy_reset();
+    last_schedule_stop = SCHEDULE_STOP_END;
+    epoch_max_dispatch = 0;
     current_cycle = 0;
     done_fetching = false;
     total_fired = 0;
     total_retired = 0;
     total_dispatch_size = 0;
     max_dispatch_size = 0;
+    total_bypass_reads = 0;
+    total_regfile_reads = 0;
+    fetch_stall_cycles = 0;
+    dispatch_stall_cycles = 0;
+    schedule_stall_cycles = 0;
+    rs_full_cycles = 0;
+    cluster_remote_wakeups = 0;
+    memset(&activity, 0, sizeof(activity));
 }
 
 /**
- * Subroutine that simulates the processor.
+ * Replaces the function unit configuration. opcode_class is indexed by op_code + 1 and
+ * holds -1 for opcodes that may not appear in the trace. The RS holds two entries per FU.
  */
-void run_proc(proc_stats_t* p_stats)
+void setup_fu_classes(const fu_class_t* classes, uint64_t n, const int32_t* opcode_class)
+{
+    uint64_t total = 0;
+
+    g_num_fu_classes = n;
+    for (uint64_t i = 0; i < n; i++) {
+        g_fu_classes[i] = classes[i];
+        total += classes[i].count;
+    }
+    memcpy(g_opcode_class, opcode_class, sizeof(g_opcode_class));
+
+    g_rs_size = 2 * total;
+
+    // Deal RS entries and units of every class round the clusters
+    memset(fu_count, 0, sizeof(fu_count));
+    memset(fu_busy, 0, sizeof(fu_busy));
+    memset(fu_issued, 0, sizeof(fu_issued));
+    memset(rs_count, 0, sizeof(rs_count));
+    memset(cluster_rs_occupancy, 0, sizeof(cluster_rs_occupancy));
+    memset(cluster_fu_busy, 0, sizeof(cluster_fu_busy));
+    memset(cluster_fired, 0, sizeof(cluster_fired));
+    for (uint64_t c = 0; c < g_num_clusters; c++) {
+        rs_capacity[c] = g_rs_size / g_num_clusters + (c < g_rs_size % g_num_clusters);
+        for (uint64_t i = 0; i < n; i++) {
+            fu_count[c][i] = classes[i].count / g_num_clusters + (c < classes[i].count % g_num_clusters);
+        }
+    }
+    steer_next = 0;
+}
+
+enum operand_state_t
+{
+    OPERAND_WAITING,  // Producer has not executed yet
+    OPERAND_BYPASS,   // Producer has EXECUTED; value only reachable over a bypass path
+    OPERAND_READY     // Value is in the register file
+};
+
+/**
+ * Where the value produced by the instruction with tag `producer` can be read this cycle
+ * by a consumer in `cluster`. Results from another cluster arrive g_xcluster_delay cycles late.
+ */
+static operand_state_t operand_state(ctag_t producer, int32_t cluster)
+{
+    if (producer == NO_TAG) {
+        return OPERAND_READY;
+    }
+
+    // Producers no longer in the table completed long ago
+    const tag_entry_t* e = tag_lookup(producer);
+    if (e == NULL) {
+        return OPERAND_READY;
+    }
+
+    uint64_t delay = e->cluster != cluster ? g_xcluster_delay : 0;
+    switch (e->location) {
+    case TAG_IN_DQ:
+        return OPERAND_WAITING;
+    case TAG_IN_RS:
+        if (e->state_update_cycle > 0 && e->state_update_cycle + delay <= current_cycle) {
+            return OPERAND_READY;
+        }
+        if (g_bypass_paths > 0 && e->executed && e->complete_cycle + delay <= current_cycle) {
+            return OPERAND_BYPASS;
+        }
+        return OPERAND_WAITING;
+    default:
+        // Left the RS; another cluster may still be waiting for the result
+        return e->state_update_cycle + delay <= current_cycle ? OPERAND_READY : OPERAND_WAITING;
+    }
+}
+
+/**
+ * Cluster holding the producer with this tag while it is in the RS or its result is still
+ * travelling to the other clusters, or -1 once the value is visible everywhere.
+ */
+static int32_t producer_cluster(ctag_t producer)
+{
+    const tag_entry_t* e = producer == NO_TAG ? NULL : tag_lookup(producer);
+    if (e == NULL || e->location == TAG_IN_DQ) {
+        return -1;
+    }
+    if (e->location == TAG_IN_RS || e->state_update_cycle + g_xcluster_delay > current_cycle) {
+        return e->cluster;
+    }
+    return -1;
+}
+
+/**
+ * Picks the cluster an instruction is scheduled into, or -1 if no cluster with a unit of
+ * its FU class has a free RS entry. Does not commit the choice (see steer_next).
+ */
+static int32_t steer_cluster(const proc_inst_t* inst)
+{
+    if (g_steer_policy == STEER_DEPENDENCE) {
+        // Follow a producer whose result is still local so the operand does not cross clusters
+        for (int i = 0; i < 2; i++) {
+            int32_t c = producer_cluster(inst->src_producer[i]);
+            if (c >= 0 && rs_count[c] < rs_capacity[c] && fu_count[c][inst->fu_type] > 0) {
+                return c;
+            }
+        }
+
+        // Otherwise the least occupied cluster
+        int32_t best = -1;
+        for (uint64_t c = 0; c < g_num_clusters; c++) {
+            if (rs_count[c] < rs_capacity[c] && fu_count[c][inst->fu_type] > 0 &&
+                (best < 0 || rs_count[c] < rs_count[best])) {
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    for (uint64_t i = 0; i < g_num_clusters; i++) {
+        uint64_t c = (steer_next + i) % g_num_clusters;
+        if (rs_count[c] < rs_capacity[c] && fu_count[c][inst->fu_type] > 0) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Whether a DQ entry could schedule this cycle: some cluster has room for it and its
+ * operands are ready, needing at most bypass_left bypass paths.
+ */
+static bool can_schedule(const proc_inst_t* inst, uint64_t bypass_left)
+{
+    int32_t cluster = 0;
+    if (g_num_clusters > 1) {
+        cluster = steer_cluster(inst);
+        if (cluster < 0) {
+            return false;
+        }
+    }
+
+    uint64_t bypass_needed = 0;
+    for (int i = 0; i < 2; i++) {
+        operand_state_t state = operand_state(inst->src_producer[i], cluster);
+        if (state == OPERAND_WAITING) {
+            return false;
+        }
+        bypass_needed += state == OPERAND_BYPASS;
+    }
+    return bypass_needed <= bypass_left;
+}
+
+PROCSIM_OBSERVER g_observer;
+
+//
+// Scheduling policies. Each supplies the fire order among ready RS entries, the order
+// completed instructions get result buses in, and how many DQ entries schedule looks at
+// per cycle. run_pipeline is instantiated once per policy, so the comparisons inline.
+//
+
+// Oldest first everywhere, with a short in-order DQ scan window (the original engine)
+struct tag_order_policy_t
+{
+    static const size_t dq_scan_window = 7;
+
+    static bool fire_before(const proc_inst_t* a, const proc_inst_t* b)
+    {
+        return a->tag < b->tag;
+    }
+
+    static bool retire_before(const proc_inst_t* a, const proc_inst_t* b)
+    {
+        if (a->complete_cycle != b->complete_cycle) {
+            return a->complete_cycle < b->complete_cycle;
+        }
+        return a->tag < b->tag;
+    }
+};
+
+// Result buses go to unpipelined FU classes first, since they hold their unit until
+// state update, then to longer-latency classes. Fire order only matters within a class,
+// so it stays oldest first.
+struct fu_priority_policy_t : tag_order_policy_t
+{
+    static bool retire_before(const proc_inst_t* a, const proc_inst_t* b)
+    {
+        const fu_class_t* fa = &g_fu_classes[a->fu_type];
+        const fu_class_t* fb = &g_fu_classes[b->fu_type];
+        if (fa->pipelined != fb->pipelined) {
+            return !fa->pipelined;
+        }
+        if (fa->latency != fb->latency) {
+            return fa->latency > fb->latency;
+        }
+        return tag_order_policy_t::retire_before(a, b);
+    }
+};
+
+// Instructions with the most dispatched dependents fire and retire first
+struct critical_path_policy_t : tag_order_policy_t
+{
+    static uint32_t consumers(const proc_inst_t* inst)
+    {
+        const tag_entry_t* e = tag_lookup(compact_tag(inst->tag));
+        return e ? e->consumers : 0;
+    }
+
+    static bool fire_before(const proc_inst_t* a, const proc_inst_t* b)
+    {
+        uint32_t ca = consumers(a), cb = consumers(b);
+        if (ca != cb) {
+            return ca > cb;
+        }
+        return a->tag < b->tag;
+    }
+
+    static bool retire_before(const proc_inst_t* a, const proc_inst_t* b)
+    {
+        uint32_t ca = consumers(a), cb = consumers(b);
+        if (ca != cb) {
+            return ca > cb;
+        }
+        return tag_order_policy_t::retire_before(a, b);
+    }
+};
+
+// Oldest first, but schedule may pick ready instructions from anywhere in the DQ
+struct wide_scan_policy_t : tag_order_policy_t
+{
+    static const size_t dq_scan_window = SIZE_MAX;
+};
+
+/**
+ * Subroutine that simulates the processor, reporting pipeline events to obs.
+ */
+template <class Policy, class Observer>
+static void run_pipeline(proc_stats_t* p_stats, Observer& obs)
 {
     bool all_done = false;
+    uint64_t watchdog_retired = total_retired;  // Retired count when the watchdog last saw progress
+    uint64_t watchdog_cycle = current_cycle;
 
+    update_regions();
     while (!all_done) {
+        if (stats_requested) {
+            stats_requested = 0;
+            print_stats_snapshot();
+        }
+        if (checkpoint_requested) {
+            checkpoint_requested = 0;
+            if (save_checkpoint(g_checkpoint_path)) {
+                fprintf(stderr, "Checkpoint at cycle %" PRIu64 " written to %s\n", current_cycle, g_checkpoint_path);
+            }
+        }
+        if (g_debug) {
+            debug_cycle(current_cycle);
+        }
+
         current_cycle++;
 
         // Track statistics
         total_dispatch_size += dispatch_queue.size();
-        if (dispatch_queue.size() > max_dispatch_size) {
-            max_dispatch_size = dispatch_queue.size();
+        if (dispatch_queue.size() > epoch_max_dispatch) {
+            epoch_max_dispatch = dispatch_queue.size();
+            max_dispatch_size = std::max(max_dispatch_size, epoch_max_dispatch);
+        }
+        if (g_occupancy) {
+            occupancy_record(OCC_FETCH_BUFFER, fetch_buffer.size());
+            occupancy_record(OCC_DQ, dispatch_queue.size());
+            occupancy_record(OCC_RS, schedule_queue.size());
         }
 
         // ==================================================================
@@ -96,113 +683,104 @@ void run_proc(proc_stats_t* p_stats)
             }
         }
 
-        // Sort by complete_cycle first (oldest), then by tag
+        // Result bus order (by default complete_cycle first (oldest), then by tag). The
+        // lambda lets the compiler inline the comparison; a function pointer would not.
         std::sort(completed_insts.begin(), completed_insts.end(),
-            [](const proc_inst_t* a, const proc_inst_t* b) {
-                if (a->complete_cycle != b->complete_cycle) {
-                    return a->complete_cycle < b->complete_cycle;
+                  [](const proc_inst_t* a, const proc_inst_t* b) { return Policy::retire_before(a, b); });
+
+        // Every broadcast this cycle is compared against the same waiting RS operands. Schedule
+        // only writes RS entries whose operands are ready, so here this stays 0.
+        uint64_t rs_waiting_operands = 0;
+        if (!completed_insts.empty()) {
+            for (const auto& inst : schedule_queue) {
+                for (int i = 0; i < 2; i++) {
+                    rs_waiting_operands += !inst.fired && !inst.src_ready[i] && inst.src_producer[i] != NO_TAG;
                 }
-                return a->tag < b->tag;
-            });
+            }
+        }
 
         // State update up to R instructions per cycle
         std::vector<uint64_t> tags_to_remove;
         for (size_t i = 0; i < completed_insts.size() && i < g_r; i++) {
             proc_inst_t* inst = completed_insts[i];
 
-            // Free FU
-            int fu_type = inst->fu_type;
-            if (fu_type == 0) {
-                for (size_t j = 0; j < fu_k0_available.size(); j++) {
-                    // Find which FU this instruction is using (we'll just free the first non-available one)
-                    if (!fu_k0_available[j]) {
-                        fu_k0_available[j] = true;
-                        break;
-                    }
-                }
-            } else if (fu_type == 1) {
-                for (size_t j = 0; j < fu_k1_available.size(); j++) {
-                    if (!fu_k1_available[j]) {
-                        fu_k1_available[j] = true;
-                        break;
-                    }
-                }
-            } else if (fu_type == 2) {
-                for (size_t j = 0; j < fu_k2_available.size(); j++) {
-                    if (!fu_k2_available[j]) {
-                        fu_k2_available[j] = true;
-                        break;
-                    }
-                }
+            // Free FU (pipelined units are only occupied in the cycle they accept an instruction)
+            if (!g_fu_classes[inst->fu_type].pipelined) {
+                fu_busy[inst->cluster][inst->fu_type]--;
             }
 
             // Mark register as ready
             if (inst->dest_reg != -1) {
-                if (register_ready[inst->dest_reg] == (int64_t)inst->tag) {
-                    register_ready[inst->dest_reg] = -1;
+                activity.scoreboard_reads++;
+                if (register_ready[inst->dest_reg] == compact_tag(inst->tag)) {
+                    register_ready[inst->dest_reg] = NO_TAG;
+                    activity.scoreboard_writes++;
                 }
             }
 
+            // The result travels on a result bus; a register result's tag is broadcast to the RS
+            activity.result_bus_transfers++;
+            if (inst->dest_reg != -1) {
+                activity.rs_wakeup_broadcasts++;
+                activity.rs_cam_searches += rs_waiting_operands;
+            }
+
             inst->state_update_cycle = current_cycle;
+            tag_lookup(compact_tag(inst->tag))->state_update_cycle = current_cycle;
             tags_to_remove.push_back(inst->tag);
             total_retired++;
 
-            printf("%lu\tSTATE UPDATE\t%lu\n", current_cycle, inst->tag);
-            fflush(stdout);
+            if (g_hotspot_top > 0) {
+                // Dispatch -> schedule and complete -> state update each take at least one cycle
+                hotspot_record(inst->instruction_address,
+                               inst->schedule_cycle - inst->dispatch_cycle - 1,
+                               inst->execute_cycle - inst->schedule_cycle,
+                               inst->state_update_cycle - inst->complete_cycle - 1);
+            }
+
+            log_event(EVENT_STATE_UPDATE, inst->tag);
+            obs.on_state_update(*inst, current_cycle);
+            if (g_critical_path) {
+                critical_state_update(inst, current_cycle);
+            }
         }
 
         // NOTE: Do NOT remove from RS here - do it in second half after schedule stage
 
-        // 2. Check for completed executions (latency = 1, so instructions that fired last cycle complete this cycle)
+        // 2. Check for completed executions (an instruction fired in cycle c with latency L completes in cycle c + L)
         for (auto& inst : schedule_queue) {
-            if (inst.fired && !inst.execution_complete && inst.execute_cycle < current_cycle) {
+            if (inst.fired && !inst.execution_complete &&
+                current_cycle >= inst.execute_cycle + g_fu_classes[inst.fu_type].latency) {
                 inst.complete_cycle = current_cycle;
                 inst.execution_complete = true;
-                printf("%lu\tEXECUTED\t%lu\n", current_cycle, inst.tag);
-                fflush(stdout);
+
+                tag_entry_t* e = tag_lookup(compact_tag(inst.tag));
+                e->executed = true;
+                e->complete_cycle = current_cycle;
+                log_event(EVENT_EXECUTED, inst.tag);
+                obs.on_execute_complete(inst, current_cycle);
+                if (g_critical_path) {
+                    critical_complete(&inst, current_cycle);
+                }
             }
         }
 
         // 3. Update ready bits for all instructions in RS
-        // A source becomes ready after its producer completes STATE UPDATE (writes to register file)
+        // A source becomes ready after its producer completes STATE UPDATE (writes to register file),
+        // or with bypassing enabled, once the producer has EXECUTED and a bypass path is free
+        uint64_t bypass_left = g_bypass_paths;
         for (auto& inst : schedule_queue) {
             if (!inst.fired) {
                 for (int i = 0; i < 2; i++) {
                     // Only update if not already ready
-                    if (!inst.src_ready[i] && inst.src_producer[i] != -1) {
-                        // Check if producer completed state update
-                        bool producer_completed = false;
-                        bool producer_found_in_rs = false;
-
-                        // Check if producer is in RS and has completed state update
-                        for (const auto& rs_inst : schedule_queue) {
-                            if (rs_inst.tag == (uint64_t)inst.src_producer[i]) {
-                                producer_found_in_rs = true;
-                                if (rs_inst.state_update_cycle > 0) {
-                                    producer_completed = true;
-                                }
-                                break;
-                            }
-                        }
-
-                        // If not in RS, check if in DQ or already completed
-                        if (!producer_found_in_rs) {
-                            bool producer_in_dq = false;
-                            for (const auto& dq_inst : dispatch_queue) {
-                                if (dq_inst.tag == (uint64_t)inst.src_producer[i]) {
-                                    producer_in_dq = true;
-                                    break;
-                                }
-                            }
-
-                            // If not in RS and not in DQ, it already completed
-                            if (!producer_in_dq) {
-                                producer_completed = true;
-                            }
-                        }
-
-                        if (producer_completed) {
+                    if (!inst.src_ready[i] && inst.src_producer[i] != NO_TAG) {
+                        operand_state_t state = operand_state(inst.src_producer[i], inst.cluster);
+                        if (state == OPERAND_READY) {
                             inst.src_ready[i] = true;
+                        } else if (state == OPERAND_BYPASS && bypass_left > 0) {
+                            bypass_left--;
+                            inst.src_ready[i] = true;
+                            inst.src_bypassed[i] = true;
                         }
                     }
                 }
@@ -214,68 +792,88 @@ void run_proc(proc_stats_t* p_stats)
         // Hybrid approach: scan from head, schedule ready instructions up to a window limit
         // This provides some out-of-order capability while maintaining program order preference
         size_t scheduled_this_cycle = 0;
-        size_t scan_limit = 7;  // Limit how far we scan into DQ
+        size_t scan_limit = Policy::dq_scan_window;  // Limit how far we scan into DQ
         size_t scanned = 0;
+        bool no_cluster_room = false;  // An entry found every cluster's RS full
         auto it = dispatch_queue.begin();
         while (it != dispatch_queue.end() && schedule_queue.size() < g_rs_size && scanned < scan_limit) {
+            if (g_schedule_width != 0 && scheduled_this_cycle == g_schedule_width) {
+                // A width stall only if an entry left in the window could have scheduled
+                size_t left = scan_limit - scanned;
+                for (auto next = it; next != dispatch_queue.end() && left > 0; ++next, left--) {
+                    if (can_schedule(&*next, bypass_left)) {
+                        schedule_stall_cycles++;
+                        break;
+                    }
+                }
+                break;
+            }
+
             proc_inst_t inst = *it;
             inst.schedule_cycle = current_cycle;
             scanned++;
 
-            // Check if sources are ready
-            bool all_ready = true;
-            for (int i = 0; i < 2; i++) {
-                if (inst.src_producer[i] == -1) {
-                    // No producer, source is ready
+            inst.cluster = 0;
+            if (g_num_clusters > 1) {
+                inst.cluster = steer_cluster(&inst);
+                if (inst.cluster < 0) {
+                    no_cluster_room = true;
+                    ++it;
                     continue;
-                } else {
-                    // Check if producer has already completed state update
-                    bool producer_completed = false;
-                    bool producer_found_in_rs = false;
-
-                    // Check if producer is in RS and has completed state update
-                    for (const auto& rs_inst : schedule_queue) {
-                        if (rs_inst.tag == (uint64_t)inst.src_producer[i]) {
-                            producer_found_in_rs = true;
-                            // Producer completed if it finished state update (value written to register file)
-                            if (rs_inst.state_update_cycle > 0) {
-                                producer_completed = true;
-                            }
-                            break;
-                        }
-                    }
-
-                    // If not in RS, check if in DQ or already completed
-                    if (!producer_found_in_rs) {
-                        bool producer_in_dq = false;
-                        for (const auto& dq_inst : dispatch_queue) {
-                            if (dq_inst.tag == (uint64_t)inst.src_producer[i]) {
-                                producer_in_dq = true;
-                                break;
-                            }
-                        }
-
-                        // If not in RS and not in DQ, it completed in a previous cycle
-                        if (!producer_in_dq) {
-                            producer_completed = true;
-                        }
-                    }
+                }
+            }
 
-                    if (!producer_completed) {
-                        all_ready = false;
-                        break;
-                    }
+            // Check if sources are ready (possibly through bypass paths)
+            operand_state_t state[2];
+            uint64_t bypass_needed = 0;
+            bool all_ready = true;
+            for (int i = 0; i < 2; i++) {
+                state[i] = operand_state(inst.src_producer[i], inst.cluster);
+                if (state[i] == OPERAND_WAITING) {
+                    all_ready = false;
+                    break;
+                }
+                if (state[i] == OPERAND_BYPASS) {
+                    bypass_needed++;
                 }
             }
+            if (bypass_needed > bypass_left) {
+                all_ready = false;
+            }
 
             if (all_ready) {
                 // Schedule this instruction (sources are ready)
                 inst.src_ready[0] = true;
                 inst.src_ready[1] = true;
+                inst.src_bypassed[0] = state[0] == OPERAND_BYPASS;
+                inst.src_bypassed[1] = state[1] == OPERAND_BYPASS;
+                bypass_left -= bypass_needed;
+
+                if (g_num_clusters > 1) {
+                    // Operands produced in another cluster, whether the value is still on
+                    // its way or has long reached every cluster
+                    for (int i = 0; i < 2; i++) {
+                        const tag_entry_t* p = inst.src_producer[i] == NO_TAG ? NULL : tag_lookup(inst.src_producer[i]);
+                        if (p != NULL && p->location != TAG_IN_DQ && p->cluster != inst.cluster) {
+                            cluster_remote_wakeups++;
+                        }
+                    }
+                    steer_next = (inst.cluster + 1) % g_num_clusters;
+                }
+                rs_count[inst.cluster]++;
+
+                tag_entry_t* e = tag_lookup(compact_tag(inst.tag));
+                e->location = TAG_IN_RS;
+                e->cluster = inst.cluster;
 
                 schedule_queue.push_back(inst);
-                printf("%lu\tSCHEDULED\t%lu\n", current_cycle, inst.tag);
-                fflush(stdout);
+                log_event(EVENT_SCHEDULED, inst.tag);
+                obs.on_schedule(inst, current_cycle);
+                if (g_critical_path) {
+                    critical_schedule(&inst, current_cycle, last_schedule_stop);
+                }
+                activity.rs_writes++;
+                activity.dq_reads++;
 
                 it = dispatch_queue.erase(it);  // Remove and advance iterator
                 scheduled_this_cycle++;
@@ -284,6 +882,18 @@ void run_proc(proc_stats_t* p_stats)
                 ++it;
             }
         }
+        if ((it != dispatch_queue.end() && scanned < scan_limit && schedule_queue.size() >= g_rs_size) ||
+            no_cluster_room) {
+            rs_full_cycles++;
+        }
+        if (g_critical_path) {
+            // Entries skipped for want of a cluster with room waited on the RS, however far
+            // the scan went after them
+            last_schedule_stop = it == dispatch_queue.end() && !no_cluster_room ? SCHEDULE_STOP_END :
+                                 g_schedule_width != 0 && scheduled_this_cycle == g_schedule_width ? SCHEDULE_STOP_WIDTH :
+                                 no_cluster_room ? SCHEDULE_STOP_RS_FULL :
+                                 scanned >= scan_limit ? SCHEDULE_STOP_WINDOW : SCHEDULE_STOP_RS_FULL;
+        }
 
         // 5. Fire ready instructions to function units (in tag order)
         // This happens AFTER scheduling so newly scheduled instructions can fire immediately (same cycle)
@@ -295,44 +905,36 @@ void run_proc(proc_stats_t* p_stats)
         }
 
         std::sort(ready_to_fire.begin(), ready_to_fire.end(),
-            [](const proc_inst_t* a, const proc_inst_t* b) { return a->tag < b->tag; });
+                  [](const proc_inst_t* a, const proc_inst_t* b) { return Policy::fire_before(a, b); });
+
+        memset(fu_issued, 0, sizeof(fu_issued));
 
         for (auto* inst : ready_to_fire) {
-            bool fired = false;
             int fu_type = inst->fu_type;
+            const fu_class_t* fu = &g_fu_classes[fu_type];
+            uint64_t* in_use = fu->pipelined ? &fu_issued[inst->cluster][fu_type] : &fu_busy[inst->cluster][fu_type];
 
-            if (fu_type == 0) {
-                for (size_t i = 0; i < fu_k0_available.size(); i++) {
-                    if (fu_k0_available[i]) {
-                        fu_k0_available[i] = false;
-                        fired = true;
-                        break;
-                    }
-                }
-            } else if (fu_type == 1) {
-                for (size_t i = 0; i < fu_k1_available.size(); i++) {
-                    if (fu_k1_available[i]) {
-                        fu_k1_available[i] = false;
-                        fired = true;
-                        break;
-                    }
-                }
-            } else if (fu_type == 2) {
-                for (size_t i = 0; i < fu_k2_available.size(); i++) {
-                    if (fu_k2_available[i]) {
-                        fu_k2_available[i] = false;
-                        fired = true;
-                        break;
-                    }
-                }
-            }
-
-            if (fired) {
+            if (*in_use < fu_count[inst->cluster][fu_type]) {
+                (*in_use)++;
                 inst->fired = true;
                 inst->execute_cycle = current_cycle;
                 total_fired++;
+                cluster_fired[inst->cluster]++;
+                activity.fu_ops[fu_type]++;
 
-                // With latency=1, instruction will complete next cycle
+                for (int i = 0; i < 2; i++) {
+                    if (inst->src_reg[i] != -1) {
+                        if (inst->src_bypassed[i]) {
+                            total_bypass_reads++;
+                        } else {
+                            total_regfile_reads++;
+                        }
+                    }
+                }
+                obs.on_fire(*inst, current_cycle);
+                if (g_critical_path) {
+                    critical_fire(inst, current_cycle);
+                }
             }
         }
 
@@ -340,8 +942,14 @@ void run_proc(proc_stats_t* p_stats)
         // SECOND HALF CYCLE
         // ==================================================================
 
-        // 6. Dispatch: Move instructions from fetch buffer to dispatch queue
-        for (auto& inst : fetch_buffer) {
+        // 6. Dispatch: Move instructions from fetch buffer to dispatch queue (up to the dispatch width)
+        size_t dispatch_count = fetch_buffer.size();
+        if (g_dispatch_width != 0 && dispatch_count > g_dispatch_width) {
+            dispatch_count = g_dispatch_width;
+            dispatch_stall_cycles++;
+        }
+        for (size_t d = 0; d < dispatch_count; d++) {
+            proc_inst_t& inst = fetch_buffer[d];
             inst.dispatch_cycle = current_cycle;
 
             // Save producer tags at dispatch time
@@ -349,29 +957,46 @@ void run_proc(proc_stats_t* p_stats)
             for (int i = 0; i < 2; i++) {
                 if (inst.src_reg[i] == -1) {
                     // No source register
-                    inst.src_producer[i] = -1;
+                    inst.src_producer[i] = NO_TAG;
                 } else if (inst.src_reg[i] == inst.dest_reg) {
                     // Self-dependency: instruction reads and writes same register
                     // This is always ready (no actual dependency)
-                    inst.src_producer[i] = -1;
+                    inst.src_producer[i] = NO_TAG;
                 } else {
                     // Save which instruction will produce this value
                     inst.src_producer[i] = register_ready[inst.src_reg[i]];
+                    tag_entry_t* producer = inst.src_producer[i] == NO_TAG ? NULL : tag_lookup(inst.src_producer[i]);
+                    if (producer != NULL) {
+                        producer->consumers++;
+                    }
+                    activity.scoreboard_reads++;
                 }
             }
 
             // Mark destination register as not ready (update scoreboard)
             if (inst.dest_reg != -1) {
-                register_ready[inst.dest_reg] = inst.tag;
+                register_ready[inst.dest_reg] = compact_tag(inst.tag);
+                activity.scoreboard_writes++;
             }
 
             dispatch_queue.push_back(inst);
-            printf("%lu\tDISPATCHED\t%lu\n", current_cycle, inst.tag);
-            fflush(stdout);
+            tag_insert(compact_tag(inst.tag));
+            activity.dq_writes++;
+            log_event(EVENT_DISPATCHED, inst.tag);
+            obs.on_dispatch(inst, current_cycle);
+            if (g_critical_path) {
+                critical_dispatch(&inst, current_cycle);
+            }
         }
-        fetch_buffer.clear();
+        fetch_buffer.erase(fetch_buffer.begin(), fetch_buffer.begin() + dispatch_count);
 
         // 7. Remove state-updated instructions from RS (second half cycle)
+        for (auto& inst : schedule_queue) {
+            if (inst.state_update_cycle == current_cycle) {
+                rs_count[inst.cluster]--;
+                tag_lookup(compact_tag(inst.tag))->location = TAG_RETIRED;
+            }
+        }
         for (uint64_t tag : tags_to_remove) {
             schedule_queue.erase(
                 std::remove_if(schedule_queue.begin(), schedule_queue.end(),
@@ -380,27 +1005,50 @@ void run_proc(proc_stats_t* p_stats)
             );
         }
 
-        // 8. Fetch: Read instructions from stdin into fetch buffer
+        // 8. Fetch: Read instructions from the trace into the free fetch buffer slots
         if (!done_fetching) {
-            for (uint64_t i = 0; i < g_f; i++) {
-                proc_inst_t inst;
-                if (read_instruction(&inst)) {
+            uint64_t fetch_slots = g_f - fetch_buffer.size();
+            if (fetch_slots < g_f) {
+                fetch_stall_cycles++;
+            }
+            for (uint64_t i = 0; i < fetch_slots; i++) {
+                if (g_max_insts != 0 && next_tag - g_first_tag >= g_max_insts) {
+                    done_fetching = true;
+                    break;
+                }
+                if (fetch_block_pos == fetch_block_len) {
+                    fetch_block_len = trace_read(g_trace, fetch_block, TRACE_BATCH);
+                    fetch_block_pos = 0;
+                }
+                if (fetch_block_pos < fetch_block_len) {
+                    proc_inst_t inst = fetch_block[fetch_block_pos++];
                     inst.tag = next_tag++;
                     inst.fetch_cycle = current_cycle;
                     inst.fired = false;
                     inst.execution_complete = false;
                     inst.state_update_cycle = 0;
+                    inst.src_bypassed[0] = false;
+                    inst.src_bypassed[1] = false;
+                    inst.cluster = 0;
 
-                    // Handle function unit type -1 -> use type 1
-                    if (inst.op_code == -1) {
-                        inst.fu_type = 1;
-                    } else {
-                        inst.fu_type = inst.op_code;
+                    // Map the opcode to its FU class (opcode -1 runs on class 1 by default)
+                    int32_t fu_type = -1;
+                    if (inst.op_code >= -1 && inst.op_code <= MAX_OPCODE) {
+                        fu_type = g_opcode_class[inst.op_code + 1];
                     }
+                    if (fu_type < 0) {
+                        fprintf(stderr, "Opcode %d of instruction %" PRIu64 " has no FU class\n",
+                                inst.op_code, inst.tag);
+                        exit(1);
+                    }
+                    inst.fu_type = fu_type;
 
                     fetch_buffer.push_back(inst);
-                    printf("%lu\tFETCHED\t%lu\n", current_cycle, inst.tag);
-                    fflush(stdout);
+                    log_event(EVENT_FETCHED, inst.tag);
+                    obs.on_fetch(inst, current_cycle);
+                    if (g_critical_path) {
+                        critical_fetch(&inst, current_cycle);
+                    }
                 } else {
                     done_fetching = true;
                     break;
@@ -414,26 +1062,703 @@ void run_proc(proc_stats_t* p_stats)
                    dispatch_queue.empty() &&
                    schedule_queue.empty();
 
+        if (g_num_clusters > 1) {
+            for (uint64_t c = 0; c < g_num_clusters; c++) {
+                cluster_rs_occupancy[c] += rs_count[c];
+                for (uint64_t i = 0; i < g_num_fu_classes; i++) {
+                    cluster_fu_busy[c] += g_fu_classes[i].pipelined ? fu_issued[c][i] : fu_busy[c][i];
+                }
+            }
+        }
+        if (g_occupancy) {
+            for (uint64_t i = 0; i < g_num_fu_classes; i++) {
+                uint64_t busy = 0;
+                for (uint64_t c = 0; c < g_num_clusters; c++) {
+                    busy += g_fu_classes[i].pipelined ? fu_issued[c][i] : fu_busy[c][i];
+                }
+                occupancy_record(OCC_FU + i, busy);
+            }
+        }
+
+        if (total_retired >= next_region_insts || current_cycle >= next_region_cycle) {
+            update_regions();
+        }
+
+        if (g_watchdog_cycles != 0) {
+            if (total_retired != watchdog_retired) {
+                watchdog_retired = total_retired;
+                watchdog_cycle = current_cycle;
+            } else if (current_cycle - watchdog_cycle >= g_watchdog_cycles) {
+                fprintf(stderr, "Watchdog: no instruction retired in %" PRIu64 " cycles (cycle %" PRIu64 ")\n",
+                        current_cycle - watchdog_cycle, current_cycle);
+                print_stats_snapshot();
+                flight_dump("watchdog");
+                exit(1);
+            }
+        }
+
+        if (g_live != NULL) {
+            publish_live_stats(all_done);
+        }
+
         // Progress indicator
-        if (current_cycle % 10000 == 0) {
-            fprintf(stderr, "Cycle %lu: RS=%lu/%lu, DQ=%lu\n",
+        if (g_print_progress && current_cycle % 10000 == 0) {
+            fprintf(stderr, "Cycle %" PRIu64 ": RS=%zu/%" PRIu64 ", DQ=%zu\n",
                     current_cycle, schedule_queue.size(), g_rs_size,
                     dispatch_queue.size());
         }
+
+        // The debugger may rewind a finished run
+        if (all_done && g_debug) {
+            all_done = !debug_finished(current_cycle);
+        }
     }
 
     p_stats->cycle_count = current_cycle;
 }
 
+typedef struct _sched_policy_entry_t
+{
+    const char* name;
+    const char* description;
+    void (*run)(proc_stats_t* p_stats, PROCSIM_OBSERVER& obs);
+} sched_policy_entry_t;
+
+// Pre-instantiated engines, selected at run time by g_sched_policy
+static const sched_policy_entry_t sched_policies[] = {
+    { "tag", "oldest first, 7-entry DQ scan (default)", run_pipeline<tag_order_policy_t, PROCSIM_OBSERVER> },
+    { "fu-priority", "unpipelined, then slower FU classes get result buses first", run_pipeline<fu_priority_policy_t, PROCSIM_OBSERVER> },
+    { "critical-path", "most dependents fire and retire first", run_pipeline<critical_path_policy_t, PROCSIM_OBSERVER> },
+    { "wide-scan", "oldest first, schedule scans the whole DQ", run_pipeline<wide_scan_policy_t, PROCSIM_OBSERVER> },
+};
+#define NUM_SCHED_POLICIES (sizeof(sched_policies) / sizeof(sched_policies[0]))
+
+int find_sched_policy(const char* name)
+{
+    for (size_t i = 0; i < NUM_SCHED_POLICIES; i++) {
+        if (strcmp(sched_policies[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void print_sched_policies(FILE* out)
+{
+    for (size_t i = 0; i < NUM_SCHED_POLICIES; i++) {
+        fprintf(out, "    %-14s%s\n", sched_policies[i].name, sched_policies[i].description);
+    }
+}
+
+void run_proc(proc_stats_t* p_stats)
+{
+    flight_armed = 1;
+    sched_policies[g_sched_policy].run(p_stats, g_observer);
+    flight_armed = 0;
+}
+
 /**
  * Subroutine for cleaning up and calculating statistics
  */
 void complete_proc(proc_stats_t *p_stats)
 {
-    p_stats->retired_instruction = total_retired;
     // Use the cycle_count that was set in run_proc for consistency
-    p_stats->avg_inst_fired = (float)total_fired / (float)p_stats->cycle_count;
-    p_stats->avg_inst_retired = (float)total_retired / (float)p_stats->cycle_count;
-    p_stats->avg_disp_size = (float)total_dispatch_size / (float)p_stats->cycle_count;
-    p_stats->max_disp_size = max_dispatch_size;
+    counter_snapshot_t start, now;
+    memset(&start, 0, sizeof(start));
+    take_snapshot(&now);
+    now.cycle = p_stats->cycle_count;
+    fill_stats(p_stats, &start, &now, max_dispatch_size);
+
+    // Regions still open end with the run
+    for (uint64_t i = 0; i < g_num_regions; i++) {
+        region_state_t* st = &region_state[i];
+        if (st->phase == REGION_ACTIVE) {
+            st->max_disp_size = std::max(st->max_disp_size, epoch_max_dispatch);
+            st->phase = REGION_DONE;
+            st->end = now;
+        }
+    }
+}
+
+/**
+ * Stats of region i once complete_proc has run. Returns false if the run never reached it.
+ */
+bool get_region_stats(uint64_t i, proc_stats_t* p_stats)
+{
+    memset(p_stats, 0, sizeof(*p_stats));
+    if (i >= g_num_regions || region_state[i].phase != REGION_DONE) {
+        return false;
+    }
+    fill_stats(p_stats, &region_state[i].begin, &region_state[i].end, region_state[i].max_disp_size);
+    return true;
+}
+
+/**
+ * Copies the activity counters collected so far.
+ */
+void get_activity(activity_t* p_activity)
+{
+    *p_activity = activity;
+}
+
+/**
+ * Per-cluster utilization of a clustered back end.
+ */
+void print_cluster_stats(FILE* out)
+{
+    uint64_t cycles = current_cycle > 0 ? current_cycle : 1;
+
+    fprintf(out, "Cluster stats (%" PRIu64 " clusters, %s steering, %" PRIu64 " cycle cross-cluster delay):\n",
+            g_num_clusters, g_steer_policy == STEER_DEPENDENCE ? "dependence" : "round-robin",
+            g_xcluster_delay);
+    fprintf(out, "Cross-cluster operands: %" PRIu64 "\n", cluster_remote_wakeups);
+    fprintf(out, "CLUSTER\tRS\tAVG RS\tFUs\tFU UTIL\tFIRED\n");
+    for (uint64_t c = 0; c < g_num_clusters; c++) {
+        uint64_t units = 0;
+        for (uint64_t i = 0; i < g_num_fu_classes; i++) {
+            units += fu_count[c][i];
+        }
+        fprintf(out, "%" PRIu64 "\t%" PRIu64 "\t%f\t%" PRIu64 "\t%f\t%" PRIu64 "\n", c, rs_capacity[c],
+                (double)cluster_rs_occupancy[c] / cycles, units,
+                units ? (double)cluster_fu_busy[c] / ((double)cycles * units) : 0.0,
+                cluster_fired[c]);
+    }
+}
+
+/**
+ * Prints the statistics complete_proc would report if the run ended now.
+ */
+void print_stats_snapshot(void)
+{
+    // Not complete_proc(), which would close the open regions
+    proc_stats_t stats;
+    counter_snapshot_t start, now;
+    memset(&start, 0, sizeof(start));
+    take_snapshot(&now);
+    fill_stats(&stats, &start, &now, max_dispatch_size);
+
+    fprintf(stderr, "Processor stats at cycle %" PRIu64 ":\n", current_cycle);
+    fprintf(stderr, "Total instructions: %" PRIu64 "\n", stats.retired_instruction);
+    fprintf(stderr, "Avg Dispatch queue size: %f\n", stats.avg_disp_size);
+    fprintf(stderr, "Maximum Dispatch queue size: %" PRIu64 "\n", stats.max_disp_size);
+    fprintf(stderr, "Avg inst fired per cycle: %f\n", stats.avg_inst_fired);
+    fprintf(stderr, "Avg inst retired per cycle: %f\n", stats.avg_inst_retired);
+    fprintf(stderr, "Total run time (cycles): %" PRIu64 "\n", stats.cycle_count);
+}
+
+// ======================================================================
+// Pipeline state views for --debug
+// ======================================================================
+
+static void format_source(char* buf, size_t n, const proc_inst_t* inst, int i, bool in_rs)
+{
+    if (inst->src_reg[i] == -1) {
+        snprintf(buf, n, "-");
+    } else if (inst->src_producer[i] == NO_TAG || (in_rs && inst->src_ready[i])) {
+        snprintf(buf, n, "r%d%s", inst->src_reg[i], in_rs && inst->src_bypassed[i] ? " (bypass)" : "");
+    } else {
+        snprintf(buf, n, "r%d<-%u", inst->src_reg[i], inst->src_producer[i]);
+    }
+}
+
+static void print_inst_row(FILE* out, const proc_inst_t* inst, bool in_rs)
+{
+    char src[2][32];
+    format_source(src[0], sizeof(src[0]), inst, 0, in_rs);
+    format_source(src[1], sizeof(src[1]), inst, 1, in_rs);
+    fprintf(out, "%" PRIu64 "\t%x\t%d\t%d\t%d\t%-12s\t%-12s", inst->tag, inst->instruction_address,
+            inst->op_code, inst->fu_type, inst->dest_reg, src[0], src[1]);
+    if (in_rs) {
+        fprintf(out, "\t%d\t", inst->cluster);
+        if (inst->fired) {
+            fprintf(out, "%" PRIu64, inst->execute_cycle);
+        } else {
+            fprintf(out, "-");
+        }
+        if (inst->execution_complete) {
+            fprintf(out, "\t%" PRIu64, inst->complete_cycle);
+        } else {
+            fprintf(out, "\t-");
+        }
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Prints up to limit instructions of a pipeline queue (0 = all), with a count line
+ * unless name is NULL.
+ */
+template <class Queue>
+static void print_queue(FILE* out, const char* name, const Queue& q, uint64_t limit, bool in_rs)
+{
+    if (name != NULL) {
+        fprintf(out, "%s: %zu instructions\n", name, q.size());
+    }
+    if (q.empty()) {
+        return;
+    }
+    fprintf(out, "TAG\tPC\tOP\tFU\tDEST\tSRC1        \tSRC2        %s\n", in_rs ? "\tCLUSTER\tFIRED\tDONE" : "");
+    uint64_t n = 0;
+    for (typename Queue::const_iterator it = q.begin(); it != q.end(); ++it) {
+        if (limit != 0 && n++ == limit) {
+            fprintf(out, "... %zu more\n", q.size() - limit);
+            break;
+        }
+        print_inst_row(out, &*it, in_rs);
+    }
+}
+
+void print_fetch_buffer(FILE* out)
+{
+    print_queue(out, "Fetch buffer", fetch_buffer, 0, false);
+}
+
+void print_dispatch_queue(FILE* out, uint64_t limit)
+{
+    print_queue(out, "Dispatch queue", dispatch_queue, limit, false);
+}
+
+void print_reservation_station(FILE* out)
+{
+    fprintf(out, "RS capacity %" PRIu64 "\n", g_rs_size);
+    print_queue(out, "Reservation station", schedule_queue, 0, true);
+}
+
+/**
+ * Units of each FU class and how many are taken: unpipelined units until their state
+ * update, pipelined ones by the instructions they accepted in the last cycle.
+ */
+void print_fu_state(FILE* out)
+{
+    fprintf(out, "CLUSTER\tCLASS\tUNITS\tLATENCY\tKIND\tIN USE\n");
+    for (uint64_t c = 0; c < g_num_clusters; c++) {
+        for (uint64_t i = 0; i < g_num_fu_classes; i++) {
+            const fu_class_t* fu = &g_fu_classes[i];
+            fprintf(out, "%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%s\t%" PRIu64 "\n",
+                    c, i, fu_count[c][i], fu->latency, fu->pipelined ? "pipe" : "unpipe",
+                    fu->pipelined ? fu_issued[c][i] : fu_busy[c][i]);
+        }
+    }
+}
+
+/**
+ * Registers with a result still outstanding and the instruction that will write them.
+ */
+void print_scoreboard(FILE* out)
+{
+    uint64_t pending = 0;
+    for (int r = 0; r < NUM_REGS; r++) {
+        if (register_ready[r] != NO_TAG) {
+            pending++;
+        }
+    }
+    fprintf(out, "Scoreboard: %" PRIu64 " of %d registers waiting\n", pending, NUM_REGS);
+    for (int r = 0; r < NUM_REGS; r++) {
+        if (register_ready[r] != NO_TAG) {
+            tag_entry_t* e = tag_lookup(register_ready[r]);
+            fprintf(out, "r%d\t<- %u%s\n", r, register_ready[r], e != NULL && e->executed ? " (executed)" : "");
+        }
+    }
+}
+
+/**
+ * Where instruction tag is in the pipeline.
+ */
+void print_instruction(FILE* out, uint64_t tag)
+{
+    for (size_t i = 0; i < fetch_buffer.size(); i++) {
+        if (fetch_buffer[i].tag == tag) {
+            fprintf(out, "In the fetch buffer, fetched in cycle %" PRIu64 "\n", fetch_buffer[i].fetch_cycle);
+            print_queue(out, NULL, std::vector<proc_inst_t>(1, fetch_buffer[i]), 0, false);
+            return;
+        }
+    }
+    for (size_t i = 0; i < schedule_queue.size(); i++) {
+        const proc_inst_t* inst = &schedule_queue[i];
+        if (inst->tag == tag) {
+            fprintf(out, "In the RS: fetched %" PRIu64 ", dispatched %" PRIu64 ", scheduled %" PRIu64 "\n",
+                    inst->fetch_cycle, inst->dispatch_cycle, inst->schedule_cycle);
+            print_queue(out, NULL, std::vector<proc_inst_t>(1, *inst), 0, true);
+            return;
+        }
+    }
+
+    bool fetched = tag >= g_first_tag && tag < next_tag;
+    tag_entry_t* e = fetched ? tag_lookup(compact_tag(tag)) : NULL;
+    if (e != NULL && e->location == TAG_IN_DQ) {
+        for (size_t i = 0; i < dispatch_queue.size(); i++) {
+            const proc_inst_t* inst = &dispatch_queue[i];
+            if (inst->tag == tag) {
+                fprintf(out, "In the dispatch queue at position %zu: fetched %" PRIu64 ", dispatched %" PRIu64 "\n",
+                        i, inst->fetch_cycle, inst->dispatch_cycle);
+                print_queue(out, NULL, std::vector<proc_inst_t>(1, *inst), 0, false);
+                return;
+            }
+        }
+    }
+    if (!fetched) {
+        fprintf(out, "Instruction %" PRIu64 " has not been fetched\n", tag);
+    } else if (e != NULL) {
+        fprintf(out, "Instruction %" PRIu64 " retired: executed in cycle %" PRIu64 ", state update in cycle %" PRIu64 "\n",
+                tag, e->complete_cycle, e->state_update_cycle);
+    } else {
+        fprintf(out, "Instruction %" PRIu64 " retired\n", tag);
+    }
+}
+
+// ======================================================================
+// Checkpoints
+// ======================================================================
+//
+// A checkpoint holds the whole engine state between two cycles. The trace
+// position is not stored; instead the next_tag - g_first_tag instructions already
+// fetched are skipped when the checkpoint is loaded.
+
+#define CHECKPOINT_MAGIC 0x4b435350u  // "PSCK"
+#define CHECKPOINT_VERSION 13
+
+static bool write_raw(FILE* out, const void* p, size_t n)
+{
+    return fwrite(p, 1, n, out) == n;
+}
+
+static bool read_raw(FILE* in, void* p, size_t n)
+{
+    return fread(p, 1, n, in) == n;
+}
+
+template <class Queue>
+static bool write_queue(FILE* out, const Queue& q)
+{
+    uint64_t n = q.size();
+    bool ok = write_raw(out, &n, sizeof(n));
+    for (typename Queue::const_iterator it = q.begin(); ok && it != q.end(); ++it) {
+        ok = write_raw(out, &*it, sizeof(*it));
+    }
+    return ok;
+}
+
+template <class Queue>
+static bool read_queue(FILE* in, Queue& q)
+{
+    uint64_t n;
+    if (!read_raw(in, &n, sizeof(n))) {
+        return false;
+    }
+    q.clear();
+    for (uint64_t i = 0; i < n; i++) {
+        typename Queue::value_type item;
+        if (!read_raw(in, &item, sizeof(item))) {
+            return false;
+        }
+        q.push_back(item);
+    }
+    return true;
+}
+
+static bool write_state(FILE* out)
+{
+    uint32_t header[2] = { CHECKPOINT_MAGIC, CHECKPOINT_VERSION };
+    uint64_t config[14] = { g_r, g_f, g_rs_size, g_num_fu_classes, g_dispatch_width, g_schedule_width,
+                            g_num_clusters, (uint64_t)g_steer_policy, g_xcluster_delay, steer_next,
+                            g_sched_policy, g_bypass_paths, g_num_regions, g_first_tag };
+    uint64_t counters[13] = { next_tag, current_cycle, done_fetching, total_fired,
+                              total_retired, total_dispatch_size, max_dispatch_size,
+                              total_bypass_reads, total_regfile_reads, fetch_stall_cycles,
+                              dispatch_stall_cycles, schedule_stall_cycles, rs_full_cycles };
+
+    bool ok = write_raw(out, header, sizeof(header)) &&
+              write_raw(out, config, sizeof(config)) &&
+              write_raw(out, g_regions, sizeof(g_regions)) &&
+              write_raw(out, counters, sizeof(counters)) &&
+              write_raw(out, register_ready, sizeof(register_ready)) &&
+              write_raw(out, g_fu_classes, sizeof(g_fu_classes)) &&
+              write_raw(out, g_opcode_class, sizeof(g_opcode_class)) &&
+              write_raw(out, fu_count, sizeof(fu_count)) &&
+              write_raw(out, fu_busy, sizeof(fu_busy)) &&
+              write_raw(out, rs_capacity, sizeof(rs_capacity)) &&
+              write_raw(out, rs_count, sizeof(rs_count)) &&
+              write_raw(out, cluster_rs_occupancy, sizeof(cluster_rs_occupancy)) &&
+              write_raw(out, cluster_fu_busy, sizeof(cluster_fu_busy)) &&
+              write_raw(out, cluster_fired, sizeof(cluster_fired)) &&
+              write_raw(out, &cluster_remote_wakeups, sizeof(cluster_remote_wakeups)) &&
+              write_queue(out, tag_table) &&
+              write_raw(out, &activity, sizeof(activity)) &&
+              write_raw(out, region_state, sizeof(region_state)) &&
+              write_raw(out, &epoch_max_dispatch, sizeof(epoch_max_dispatch)) &&
+              write_queue(out, fetch_buffer) &&
+              write_queue(out, dispatch_queue) &&
+              write_queue(out, schedule_queue);
+    for (int i = 0; ok && i < NUM_OCC_HISTS; i++) {
+        ok = write_queue(out, occupancy_hist[i]);
+    }
+
+    // The hotspot table, and whether it covers the run so far
+    uint64_t hotspots_recorded = g_hotspot_top > 0;
+    std::vector<hotspot_entry_t> hotspots;
+    hotspot_save(&hotspots);
+    return ok && write_raw(out, &hotspots_recorded, sizeof(hotspots_recorded)) &&
+           write_queue(out, hotspots);
+}
+
+/**
+ * Writes the engine state to path (via a temporary file, so a crash never leaves a torn checkpoint).
+ */
+bool save_checkpoint(const char* path)
+{
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* out = fopen(tmp.c_str(), "wb");
+    if (out == NULL) {
+        perror(tmp.c_str());
+        return false;
+    }
+
+    bool ok = write_state(out);
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        fprintf(stderr, "Failed to write checkpoint %s\n", path);
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Everything read_state() replaces, read and checked before any of it is committed
+typedef struct _saved_state_t
+{
+    uint64_t config[14];
+    uint64_t counters[13];
+    decltype(::g_regions) regions;
+    decltype(::register_ready) register_ready;
+    decltype(::g_fu_classes) fu_classes;
+    decltype(::g_opcode_class) opcode_class;
+    decltype(::fu_count) fu_count;
+    decltype(::fu_busy) fu_busy;
+    decltype(::rs_capacity) rs_capacity;
+    decltype(::rs_count) rs_count;
+    decltype(::cluster_rs_occupancy) cluster_rs_occupancy;
+    decltype(::cluster_fu_busy) cluster_fu_busy;
+    decltype(::cluster_fired) cluster_fired;
+    uint64_t cluster_remote_wakeups;
+    decltype(::tag_table) tag_table;
+    activity_t activity;
+    decltype(::region_state) region_state;
+    uint64_t epoch_max_dispatch;
+    decltype(::fetch_buffer) fetch_buffer;
+    decltype(::dispatch_queue) dispatch_queue;
+    decltype(::schedule_queue) schedule_queue;
+    std::vector<uint64_t> occupancy_hist[NUM_OCC_HISTS];
+    uint64_t hotspots_recorded;
+    std::vector<hotspot_entry_t> hotspots;
+} saved_state_t;
+
+/**
+ * Whether the instructions of a saved queue only name FU classes (and, once scheduled,
+ * clusters) the saved configuration has.
+ */
+template <class Queue>
+static bool valid_queue(const Queue& q, uint64_t num_fu_classes, uint64_t num_clusters, bool scheduled)
+{
+    for (const proc_inst_t& inst : q) {
+        if (inst.fu_type < 0 || (uint64_t)inst.fu_type >= num_fu_classes) {
+            return false;
+        }
+        if (scheduled && (inst.cluster < 0 || (uint64_t)inst.cluster >= num_clusters)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Replaces the engine state (including the configuration given to setup_proc) with the
+ * one write_state() stored. The trace is left where it is. A short or inconsistent file
+ * leaves the engine untouched.
+ */
+static bool read_state(FILE* in)
+{
+    uint32_t header[2];
+    if (!read_raw(in, header, sizeof(header)) || header[0] != CHECKPOINT_MAGIC) {
+        return false;
+    }
+    if (header[1] != CHECKPOINT_VERSION) {
+        fprintf(stderr, "Checkpoint version %u is not supported (this build reads version %u)\n",
+                header[1], CHECKPOINT_VERSION);
+        return false;
+    }
+
+    saved_state_t* st = new saved_state_t();
+    bool ok = read_raw(in, st->config, sizeof(st->config)) &&
+              read_raw(in, st->regions, sizeof(st->regions)) &&
+              read_raw(in, st->counters, sizeof(st->counters)) &&
+              read_raw(in, st->register_ready, sizeof(st->register_ready)) &&
+              read_raw(in, st->fu_classes, sizeof(st->fu_classes)) &&
+              read_raw(in, st->opcode_class, sizeof(st->opcode_class)) &&
+              read_raw(in, st->fu_count, sizeof(st->fu_count)) &&
+              read_raw(in, st->fu_busy, sizeof(st->fu_busy)) &&
+              read_raw(in, st->rs_capacity, sizeof(st->rs_capacity)) &&
+              read_raw(in, st->rs_count, sizeof(st->rs_count)) &&
+              read_raw(in, st->cluster_rs_occupancy, sizeof(st->cluster_rs_occupancy)) &&
+              read_raw(in, st->cluster_fu_busy, sizeof(st->cluster_fu_busy)) &&
+              read_raw(in, st->cluster_fired, sizeof(st->cluster_fired)) &&
+              read_raw(in, &st->cluster_remote_wakeups, sizeof(st->cluster_remote_wakeups)) &&
+              read_queue(in, st->tag_table) &&
+              read_raw(in, &st->activity, sizeof(st->activity)) &&
+              read_raw(in, st->region_state, sizeof(st->region_state)) &&
+              read_raw(in, &st->epoch_max_dispatch, sizeof(st->epoch_max_dispatch)) &&
+              read_queue(in, st->fetch_buffer) &&
+              read_queue(in, st->dispatch_queue) &&
+              read_queue(in, st->schedule_queue);
+    for (int i = 0; ok && i < NUM_OCC_HISTS; i++) {
+        ok = read_queue(in, st->occupancy_hist[i]);
+    }
+    ok = ok && read_raw(in, &st->hotspots_recorded, sizeof(st->hotspots_recorded)) &&
+         read_queue(in, st->hotspots);
+    if (ok && g_hotspot_top > 0 && !st->hotspots_recorded) {
+        fprintf(stderr, "The checkpoint was written without --hotspots, so the hotspots would only cover the resumed cycles\n");
+        delete st;
+        return false;
+    }
+
+    // The configuration sizes the tables the engine indexes with it
+    const uint64_t* config = st->config;
+    uint64_t num_fu_classes = config[3], num_clusters = config[6];
+    size_t tags = st->tag_table.size();
+    ok = ok && num_fu_classes >= 1 && num_fu_classes <= MAX_FU_CLASSES &&
+         num_clusters >= 1 && num_clusters <= MAX_CLUSTERS &&
+         config[7] <= STEER_DEPENDENCE && config[9] < num_clusters &&
+         config[12] <= MAX_REGIONS && config[13] != 0 &&
+         tags != 0 && (tags & (tags - 1)) == 0;
+    for (size_t i = 0; ok && i < sizeof(st->opcode_class) / sizeof(st->opcode_class[0]); i++) {
+        ok = st->opcode_class[i] >= -1 && st->opcode_class[i] < (int32_t)num_fu_classes;
+    }
+    ok = ok && valid_queue(st->fetch_buffer, num_fu_classes, num_clusters, false) &&
+         valid_queue(st->dispatch_queue, num_fu_classes, num_clusters, false) &&
+         valid_queue(st->schedule_queue, num_fu_classes, num_clusters, true);
+    if (!ok) {
+        delete st;
+        return false;
+    }
+
+    g_r = config[0];
+    g_f = config[1];
+    g_rs_size = config[2];
+    g_num_fu_classes = config[3];
+    g_dispatch_width = config[4];
+    g_schedule_width = config[5];
+    g_num_clusters = config[6];
+    g_steer_policy = (steer_policy_t)config[7];
+    g_xcluster_delay = config[8];
+    steer_next = config[9];
+    g_sched_policy = config[10] < NUM_SCHED_POLICIES ? config[10] : 0;
+    g_bypass_paths = config[11];
+    g_num_regions = config[12];
+    g_first_tag = config[13];
+
+    const uint64_t* counters = st->counters;
+    next_tag = counters[0];
+    current_cycle = counters[1];
+    done_fetching = counters[2] != 0;
+    total_fired = counters[3];
+    total_retired = counters[4];
+    total_dispatch_size = counters[5];
+    max_dispatch_size = counters[6];
+    total_bypass_reads = counters[7];
+    total_regfile_reads = counters[8];
+    fetch_stall_cycles = counters[9];
+    dispatch_stall_cycles = counters[10];
+    schedule_stall_cycles = counters[11];
+    rs_full_cycles = counters[12];
+
+    memcpy(g_regions, st->regions, sizeof(g_regions));
+    memcpy(register_ready, st->register_ready, sizeof(register_ready));
+    memcpy(g_fu_classes, st->fu_classes, sizeof(g_fu_classes));
+    memcpy(g_opcode_class, st->opcode_class, sizeof(g_opcode_class));
+    memcpy(fu_count, st->fu_count, sizeof(fu_count));
+    memcpy(fu_busy, st->fu_busy, sizeof(fu_busy));
+    memcpy(rs_capacity, st->rs_capacity, sizeof(rs_capacity));
+    memcpy(rs_count, st->rs_count, sizeof(rs_count));
+    memcpy(cluster_rs_occupancy, st->cluster_rs_occupancy, sizeof(cluster_rs_occupancy));
+    memcpy(cluster_fu_busy, st->cluster_fu_busy, sizeof(cluster_fu_busy));
+    memcpy(cluster_fired, st->cluster_fired, sizeof(cluster_fired));
+    cluster_remote_wakeups = st->cluster_remote_wakeups;
+    tag_table.swap(st->tag_table);
+    tag_mask = tag_table.size() - 1;
+    activity = st->activity;
+    memcpy(region_state, st->region_state, sizeof(region_state));
+    epoch_max_dispatch = st->epoch_max_dispatch;
+    fetch_buffer.swap(st->fetch_buffer);
+    dispatch_queue.swap(st->dispatch_queue);
+    schedule_queue.swap(st->schedule_queue);
+    for (int i = 0; i < NUM_OCC_HISTS; i++) {
+        occupancy_hist[i].swap(st->occupancy_hist[i]);
+    }
+    hotspot_restore(st->hotspots);
+    delete st;
+
+    fetch_block_len = 0;
+    fetch_block_pos = 0;
+    return true;
+}
+
+/**
+ * Replaces the engine state (including the configuration given to setup_proc) with a
+ * checkpoint and skips the instructions it had already fetched.
+ */
+bool load_checkpoint(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+    bool ok = read_state(in);
+    fclose(in);
+
+    if (!ok) {
+        fprintf(stderr, "%s is not a valid checkpoint\n", path);
+        return false;
+    }
+    uint64_t position = next_tag - g_first_tag;
+    if (trace_skip(g_trace, position) != position) {
+        fprintf(stderr, "Trace ended before checkpoint position %" PRIu64 "\n", position);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Copies the engine state into buf, in checkpoint format.
+ */
+bool save_snapshot(std::vector<char>& buf)
+{
+    char* data = NULL;
+    size_t size = 0;
+    FILE* out = open_memstream(&data, &size);
+    if (out == NULL) {
+        return false;
+    }
+    bool ok = write_state(out);
+    ok = (fclose(out) == 0) && ok;
+    if (ok) {
+        buf.assign(data, data + size);
+    }
+    free(data);
+    return ok;
+}
+
+/**
+ * Returns the engine to a save_snapshot() state. The trace is rewound and replayed up
+ * to the snapshot's position, so it must be a memory or synthetic source.
+ */
+bool restore_snapshot(const std::vector<char>& buf)
+{
+    FILE* in = fmemopen((void*)buf.data(), buf.size(), "rb");
+    if (in == NULL) {
+        return false;
+    }
+    bool ok = read_state(in);
+    fclose(in);
+    return ok && trace_rewind(g_trace) &&
+           trace_skip(g_trace, next_tag - g_first_tag) == next_tag - g_first_tag;
 }
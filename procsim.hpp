@@ -12,6 +12,21 @@
 #define DEFAULT_R 8
 #define DEFAULT_F 4
 #define NUM_REGS 128
+#define MAX_FU_CLASSES 16
+#define MAX_CLUSTERS 8
+#define MAX_OPCODE 255
+#define MAX_REGIONS 4
+#define DEFAULT_CHECKPOINT_PATH "procsim.ckpt"
+
+// Dependence tracking stores 32-bit tags. Sequence numbers wrap into [1, 2^32 - 1] so
+// traces longer than 4G instructions keep working; 0 is never a live tag.
+typedef uint32_t ctag_t;
+#define NO_TAG ((ctag_t)0)
+
+static inline ctag_t compact_tag(uint64_t tag)
+{
+    return (ctag_t)((tag - 1) % UINT32_MAX) + 1;
+}
 
 typedef struct _proc_inst_t
 {
@@ -28,28 +43,129 @@ typedef struct _proc_inst_t
     uint64_t execute_cycle;      // Cycle when instruction entered execute
     uint64_t state_update_cycle; // Cycle when instruction entered state update
     bool src_ready[2];           // Ready bits for source registers
-    int64_t src_producer[2];     // Tag of instruction that will produce each source (-1 if ready)
+    bool src_bypassed[2];        // Source value was forwarded on a bypass path
+    ctag_t src_producer[2];      // Compact tag of instruction that will produce each source (NO_TAG if ready)
     bool fired;                  // Has this instruction been fired to FU?
-    int32_t fu_type;             // Actual FU type to use (handling -1 case)
+    int32_t fu_type;             // FU class to use (from the opcode -> class table)
+    int32_t cluster;             // Back-end cluster the instruction was scheduled into
     uint64_t complete_cycle;     // Cycle when execution completes
     bool execution_complete;     // Has execution finished (waiting for result bus)?
 
 } proc_inst_t;
 
+typedef struct _fu_class_t
+{
+    uint64_t count;              // Number of units in the class
+    uint64_t latency;            // Cycles from fire to execution complete
+    bool pipelined;              // Accepts a new instruction every cycle instead of holding until state update
+} fu_class_t;
+
+typedef enum _steer_policy_t
+{
+    STEER_ROUND_ROBIN,           // Next cluster in turn with a free RS entry
+    STEER_DEPENDENCE             // Cluster of an in-flight producer, else the least occupied
+} steer_policy_t;
+
+// Events per modeled structure, combined with per-event energies for power estimates
+typedef struct _activity_t
+{
+    uint64_t dq_writes;              // Instructions dispatched into the DQ
+    uint64_t dq_reads;               // Instructions read out of the DQ by schedule
+    uint64_t rs_writes;              // RS entries allocated
+    uint64_t rs_wakeup_broadcasts;   // Result tags (of instructions with a destination) broadcast to the RS
+    uint64_t rs_cam_searches;        // Broadcast tags compared against RS source operands still waiting
+    uint64_t result_bus_transfers;   // Results moved on a result bus
+    uint64_t scoreboard_reads;
+    uint64_t scoreboard_writes;
+    uint64_t fu_ops[MAX_FU_CLASSES]; // Instructions fired per FU class
+} activity_t;
+
+// Pipeline events, in the order an instruction reaches them
+enum pipeline_event_t
+{
+    EVENT_FETCHED,
+    EVENT_DISPATCHED,
+    EVENT_SCHEDULED,
+    EVENT_EXECUTED,
+    EVENT_STATE_UPDATE,
+    NUM_PIPELINE_EVENTS
+};
+
+// Event names as printed in the event log
+extern const char* const g_event_names[NUM_PIPELINE_EVENTS];
+
+// Part of the run with its own stats, e.g. the warm-up or a region of interest
+typedef struct _region_t
+{
+    char name[16];
+    bool in_cycles;              // start/end count cycles instead of retired instructions
+    uint64_t start;
+    uint64_t end;                // 0 = until the end of the run
+} region_t;
+
 typedef struct _proc_stats_t
 {
-    float avg_inst_retired;
-    float avg_inst_fired;
-    float avg_disp_size;
-    unsigned long max_disp_size;
-    unsigned long retired_instruction;
-    unsigned long cycle_count;
+    double avg_inst_retired;
+    double avg_inst_fired;
+    double avg_disp_size;
+    uint64_t max_disp_size;
+    uint64_t retired_instruction;
+    uint64_t cycle_count;
+    uint64_t bypass_reads;
+    uint64_t regfile_reads;
+    uint64_t fetch_stall_cycles;
+    uint64_t dispatch_stall_cycles;
+    uint64_t schedule_stall_cycles;
+    uint64_t rs_full_cycles;
 } proc_stats_t;
 
-bool read_instruction(proc_inst_t* p_inst);
+// Engine options, set before setup_proc()
+extern bool g_print_events;
+extern bool g_print_progress;
+extern uint64_t g_max_insts;
+extern const char* g_checkpoint_path;
+extern uint64_t g_bypass_paths;
+extern uint64_t g_dispatch_width;
+extern uint64_t g_schedule_width;
+extern uint64_t g_num_fu_classes;
+extern fu_class_t g_fu_classes[MAX_FU_CLASSES];
+extern uint64_t g_num_clusters;
+extern steer_policy_t g_steer_policy;
+extern uint64_t g_xcluster_delay;
+extern uint64_t g_sched_policy;
+extern region_t g_regions[MAX_REGIONS];
+extern uint64_t g_num_regions;
+extern uint64_t g_watchdog_cycles;
+extern uint64_t g_first_tag;
+
+// Set by setup_proc()
+extern uint64_t g_r;
+extern uint64_t g_f;
+extern uint64_t g_rs_size;
 
 void setup_proc(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f);
+void setup_fu_classes(const fu_class_t* classes, uint64_t n, const int32_t* opcode_class);
 void run_proc(proc_stats_t* p_stats);
 void complete_proc(proc_stats_t* p_stats);
+bool get_region_stats(uint64_t i, proc_stats_t* p_stats);
+
+int find_sched_policy(const char* name);
+void print_sched_policies(FILE* out);
+
+void install_proc_signal_handlers(void);
+void print_stats_snapshot(void);
+void print_cluster_stats(FILE* out);
+void get_activity(activity_t* p_activity);
+bool save_checkpoint(const char* path);
+bool load_checkpoint(const char* path);
+bool save_snapshot(std::vector<char>& buf);
+bool restore_snapshot(const std::vector<char>& buf);
+
+void print_fetch_buffer(FILE* out);
+void print_dispatch_queue(FILE* out, uint64_t limit);
+void print_reservation_station(FILE* out);
+void print_fu_state(FILE* out);
+void print_scoreboard(FILE* out);
+void print_instruction(FILE* out, uint64_t tag);
 
 #endif /* PROCSIM_HPP */
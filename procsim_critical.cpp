@@ -0,0 +1,333 @@
+#include "procsim_critical.hpp"
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+
+//
+// Critical path analysis (--critical-path). Every pipeline event is a node of a graph
+// whose edges are the constraints between events: in-order fetch, stage latencies,
+// producer -> consumer, FU latency, and the waits for DQ order, RS entries, FUs and
+// result buses. The last event of the run ends the critical path, and the cycles along
+// it add up to cycle_count.
+//
+// The graph is never stored. Each event keeps only a vector of how many cycles (and
+// edges) of each kind lie on the critical path leading to it: the vector of the
+// constraint that was satisfied last, plus the edge from there. Vectors live in a ring
+// indexed by tag that only holds instructions still in flight or with consumers that
+// have not scheduled, so memory is bounded by the in-flight window, not the trace.
+//
+// A wait for a resource follows the edge from the event that released it: the older
+// instruction that left the DQ, the state update that freed an RS entry or result bus,
+// the dispatch that made room. Which resource held an instruction in the DQ comes from
+// why the schedule stage stopped in the cycle before it scheduled. When no such event
+// is found the wait is charged along the instruction's own chain instead. FU waits are
+// always charged that way: an instruction only schedules once its operands are ready,
+// so the cycles from SCHEDULED to its fire are FU contention, and the path through its
+// own chain is as long as the one through the state update that freed the unit.
+//
+
+#define MIN_CP_NODES 4096
+
+bool g_critical_path = false;
+
+static std::vector<cp_node_t> nodes;
+static uint64_t node_mask = 0;
+
+static cp_vector_t last_fetch_path;
+static uint64_t last_fetch_cycle = 0;
+static cp_vector_t end_path;        // Path to the latest STATE UPDATE
+static uint64_t end_cycle = 0;
+
+// Resource waits of all instructions, and how many were traced to the releasing event
+static uint64_t waits = 0;
+static uint64_t waits_released = 0;
+
+// The last event of one kind in each of the two latest cycles it happened in
+typedef struct _cp_release_t
+{
+    uint64_t cycle[2];           // [0] latest, [1] the one before
+    cp_vector_t path[2];
+} cp_release_t;
+
+static cp_release_t dispatches;
+static cp_release_t schedules;
+static cp_release_t state_updates;
+
+static const char* const edge_names[NUM_CP_EDGES] = {
+    "fetch bandwidth", "pipeline latency", "dispatch width", "DQ order", "RS capacity",
+    "data dependence", "FU contention", "execution latency", "result bus"
+};
+
+/**
+ * Adds a wait along the instruction's own chain; nothing if it did not wait.
+ */
+static inline void add_edge(cp_vector_t* v, cp_edge_t kind, uint64_t cycles)
+{
+    if (cycles > 0) {
+        v->cycles[kind] += cycles;
+        v->edges[kind]++;
+    }
+}
+
+/**
+ * Adds an edge taken from another instruction's event, which is on the path even when it
+ * costs no cycles.
+ */
+static inline void follow_edge(cp_vector_t* v, cp_edge_t kind, uint64_t cycles)
+{
+    v->cycles[kind] += cycles;
+    v->edges[kind]++;
+}
+
+static void record_release(cp_release_t* r, uint64_t cycle, const cp_vector_t* path)
+{
+    if (r->cycle[0] != cycle) {
+        r->cycle[1] = r->cycle[0];
+        r->path[1] = r->path[0];
+        r->cycle[0] = cycle;
+    }
+    r->path[0] = *path;
+}
+
+/**
+ * Critical path of the last event of the kind in cycles [first, last], or NULL if there
+ * was none; *p_cycle is the cycle it happened in. last is at least the cycle before the
+ * current one, so the two cycles kept always hold the latest event up to it.
+ */
+static const cp_vector_t* latest_release(const cp_release_t* r, uint64_t first, uint64_t last,
+                                         uint64_t* p_cycle)
+{
+    for (int i = 0; i < 2; i++) {
+        if (r->cycle[i] != 0 && r->cycle[i] <= last) {
+            if (r->cycle[i] < first) {
+                return NULL;
+            }
+            *p_cycle = r->cycle[i];
+            return &r->path[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Takes the path through the last event that released a resource during the wait, up to
+ * release_cycle, if there was one, else charges the wait along path. A release before the
+ * last cycle means the resource went to others first, or the instruction was held by
+ * something else in between; either way that release is the latest one it waited for.
+ */
+static void wait_for(cp_vector_t* path, cp_edge_t kind, uint64_t wait, const cp_release_t* r,
+                     uint64_t release_cycle, uint64_t cycle)
+{
+    uint64_t when = 0;
+    const cp_vector_t* release = wait > 0 ? latest_release(r, cycle - wait, release_cycle, &when) : NULL;
+    waits += wait > 0;
+    waits_released += release != NULL;
+    if (release != NULL) {
+        *path = *release;
+        follow_edge(path, kind, cycle - when);
+    } else {
+        add_edge(path, kind, wait);
+    }
+}
+
+static inline bool node_live(const cp_node_t* n)
+{
+    return n->tag != NO_TAG && !(n->retired && n->pending_consumers == 0);
+}
+
+static inline cp_node_t* node_lookup(ctag_t tag)
+{
+    cp_node_t* n = &nodes[tag & node_mask];
+    return n->tag == tag ? n : NULL;
+}
+
+/**
+ * Rebuilds the ring at twice the size, dropping nodes nothing needs any more.
+ */
+static void nodes_grow(void)
+{
+    std::vector<cp_node_t> old;
+    old.swap(nodes);
+
+    nodes.assign(old.size() * 2, cp_node_t());
+    node_mask = nodes.size() - 1;
+    for (size_t i = 0; i < old.size(); i++) {
+        if (node_live(&old[i])) {
+            nodes[old[i].tag & node_mask] = old[i];
+        }
+    }
+}
+
+void critical_reset(void)
+{
+    nodes.assign(MIN_CP_NODES, cp_node_t());
+    node_mask = MIN_CP_NODES - 1;
+    memset(&last_fetch_path, 0, sizeof(last_fetch_path));
+    memset(&end_path, 0, sizeof(end_path));
+    memset(&dispatches, 0, sizeof(dispatches));
+    memset(&schedules, 0, sizeof(schedules));
+    memset(&state_updates, 0, sizeof(state_updates));
+    last_fetch_cycle = 0;
+    end_cycle = 0;
+    waits = 0;
+    waits_released = 0;
+}
+
+void critical_fetch(const proc_inst_t* inst, uint64_t cycle)
+{
+    ctag_t tag = compact_tag(inst->tag);
+    cp_node_t* n = &nodes[tag & node_mask];
+    while (node_live(n)) {
+        nodes_grow();
+        n = &nodes[tag & node_mask];
+    }
+    memset(n, 0, sizeof(*n));
+    n->tag = tag;
+
+    // One cycle per fetch group; longer gaps mean the fetch buffer was full until a
+    // dispatch earlier in this cycle made room
+    uint64_t gap = cycle - last_fetch_cycle;
+    n->path = last_fetch_path;
+    if (gap > 1) {
+        wait_for(&n->path, CP_DISPATCH, gap, &dispatches, cycle, cycle);
+    } else {
+        add_edge(&n->path, CP_FETCH, gap);
+    }
+    n->time = cycle;
+
+    last_fetch_path = n->path;
+    last_fetch_cycle = cycle;
+}
+
+void critical_dispatch(const proc_inst_t* inst, uint64_t cycle)
+{
+    cp_node_t* n = node_lookup(compact_tag(inst->tag));
+    if (n == NULL) {
+        return;
+    }
+    // The dispatch width held it in the fetch buffer behind the last cycle's dispatches
+    uint64_t wait = cycle - n->time - 1;
+    add_edge(&n->path, CP_PIPELINE, 1);
+    wait_for(&n->path, CP_DISPATCH, wait, &dispatches, cycle - 1, cycle);
+    n->time = cycle;
+    record_release(&dispatches, cycle, &n->path);
+
+    for (int i = 0; i < 2; i++) {
+        cp_node_t* p = inst->src_producer[i] == NO_TAG ? NULL : node_lookup(inst->src_producer[i]);
+        if (p != NULL) {
+            p->pending_consumers++;
+        }
+    }
+}
+
+void critical_schedule(const proc_inst_t* inst, uint64_t cycle, schedule_stop_t prev_stop)
+{
+    cp_node_t* n = node_lookup(compact_tag(inst->tag));
+    if (n == NULL) {
+        return;
+    }
+
+    // The constraint satisfied last: dispatch one cycle earlier, or an operand arriving
+    cp_vector_t path = n->path;
+    add_edge(&path, CP_PIPELINE, 1);
+    uint64_t ready = n->time + 1;
+    for (int i = 0; i < 2; i++) {
+        cp_node_t* p = inst->src_producer[i] == NO_TAG ? NULL : node_lookup(inst->src_producer[i]);
+        if (p == NULL) {
+            continue;
+        }
+        p->pending_consumers--;
+
+        uint64_t produced = inst->src_bypassed[i] ? p->complete_cycle : p->state_update_cycle;
+        uint64_t arrival = produced + (p->cluster != inst->cluster ? g_xcluster_delay : 0);
+        if (produced != 0 && arrival >= ready) {
+            path = inst->src_bypassed[i] ? p->complete_path : p->path;
+            follow_edge(&path, CP_DATA, arrival - produced);
+            ready = arrival;
+        }
+    }
+
+    // Whatever held it back after that: older instructions ahead of it in the DQ, the
+    // last of which left by the last cycle, or a full RS, which a state update freed
+    uint64_t wait = cycle > ready ? cycle - ready : 0;
+    if (prev_stop == SCHEDULE_STOP_WINDOW || prev_stop == SCHEDULE_STOP_WIDTH) {
+        wait_for(&path, CP_DQ_ORDER, wait, &schedules, cycle - 1, cycle);
+    } else if (prev_stop == SCHEDULE_STOP_RS_FULL || g_num_clusters > 1) {
+        // A skipped instruction in a clustered back end found no cluster with room
+        wait_for(&path, CP_RS, wait, &state_updates, cycle - 1, cycle);
+    } else {
+        // Looked at and skipped: no bypass path was free
+        add_edge(&path, CP_DATA, wait);
+    }
+
+    n->path = path;
+    n->cluster = inst->cluster;
+    n->time = cycle;
+    record_release(&schedules, cycle, &n->path);
+}
+
+void critical_fire(const proc_inst_t* inst, uint64_t cycle)
+{
+    cp_node_t* n = node_lookup(compact_tag(inst->tag));
+    if (n == NULL) {
+        return;
+    }
+
+    // Its operands were ready when it scheduled, so any wait since was for a free FU
+    add_edge(&n->path, CP_FU, cycle - n->time);
+    n->time = cycle;
+}
+
+void critical_complete(const proc_inst_t* inst, uint64_t cycle)
+{
+    cp_node_t* n = node_lookup(compact_tag(inst->tag));
+    if (n != NULL) {
+        add_edge(&n->path, CP_EXECUTE, cycle - n->time);
+        n->time = cycle;
+        n->complete_cycle = cycle;
+        n->complete_path = n->path;
+    }
+}
+
+void critical_state_update(const proc_inst_t* inst, uint64_t cycle)
+{
+    cp_node_t* n = node_lookup(compact_tag(inst->tag));
+    if (n == NULL) {
+        return;
+    }
+    // All result buses went to others in the last cycle
+    add_edge(&n->path, CP_PIPELINE, 1);
+    wait_for(&n->path, CP_RESULT_BUS, cycle - n->time - 1, &state_updates, cycle - 1, cycle);
+    n->time = cycle;
+    n->state_update_cycle = cycle;
+    n->retired = true;
+    record_release(&state_updates, cycle, &n->path);
+
+    if (cycle >= end_cycle) {
+        end_cycle = cycle;
+        end_path = n->path;
+    }
+}
+
+/**
+ * Cycles and edges of each kind on the path to the last STATE UPDATE of the run.
+ */
+void print_critical_path(FILE* out, uint64_t cycle_count)
+{
+    uint64_t total = 0, edges = 0;
+    for (int i = 0; i < NUM_CP_EDGES; i++) {
+        total += end_path.cycles[i];
+        edges += end_path.edges[i];
+    }
+
+    fprintf(out, "Critical path (%" PRIu64 " cycles over %" PRIu64 " edges, run %" PRIu64 " cycles, ring %zu nodes):\n",
+            total, edges, cycle_count, nodes.size());
+    fprintf(out, "EDGE\tCYCLES\tSHARE\tEDGES\n");
+    for (int i = 0; i < NUM_CP_EDGES; i++) {
+        fprintf(out, "%s\t%" PRIu64 "\t%.2f%%\t%" PRIu64 "\n", edge_names[i], end_path.cycles[i],
+                total ? 100.0 * end_path.cycles[i] / total : 0.0, end_path.edges[i]);
+    }
+    // Waits not traced were charged along the waiting instruction's own chain
+    fprintf(out, "Waits traced to the releasing event: %" PRIu64 " of %" PRIu64 " (%.2f%%)\n", waits_released,
+            waits, waits ? 100.0 * waits_released / waits : 0.0);
+}
@@ -0,0 +1,66 @@
+#ifndef PROCSIM_CRITICAL_HPP
+#define PROCSIM_CRITICAL_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include "procsim.hpp"
+
+// Kinds of edge in the pipeline event graph
+enum cp_edge_t
+{
+    CP_FETCH,          // Fetch bandwidth: in-order fetch, F instructions per cycle
+    CP_PIPELINE,       // Fixed one-cycle stage latencies (fetch -> dispatch -> schedule, complete -> state update)
+    CP_DISPATCH,       // Fetch buffer held back by the dispatch width
+    CP_DQ_ORDER,       // Waiting in the DQ behind older instructions (scan window, schedule width)
+    CP_RS,             // Waiting for a free RS entry
+    CP_DATA,           // Producer result -> consumer (cross-cluster delay, bypass path shortage)
+    CP_FU,             // Waiting for a free function unit
+    CP_EXECUTE,        // FU latency
+    CP_RESULT_BUS,     // Waiting for a result bus
+    NUM_CP_EDGES
+};
+
+// Why the schedule stage stopped scanning the DQ in a cycle
+enum schedule_stop_t
+{
+    SCHEDULE_STOP_END,     // Looked at every DQ entry
+    SCHEDULE_STOP_WINDOW,  // Reached the policy's scan window
+    SCHEDULE_STOP_RS_FULL, // The RS, or in a clustered back end every cluster with room for an entry, was full
+    SCHEDULE_STOP_WIDTH    // Scheduled g_schedule_width instructions
+};
+
+// Cycles and edges of each kind on the critical path to one event
+typedef struct _cp_vector_t
+{
+    uint64_t cycles[NUM_CP_EDGES];
+    uint64_t edges[NUM_CP_EDGES];
+} cp_vector_t;
+
+// Analysis state of one instruction, kept until it has retired and all its consumers
+// have scheduled
+typedef struct _cp_node_t
+{
+    ctag_t tag;                  // NO_TAG = free slot
+    int32_t cluster;
+    uint32_t pending_consumers;  // Dispatched consumers that have not scheduled yet
+    bool retired;
+    uint64_t time;               // Cycle of the latest event of the instruction
+    uint64_t complete_cycle;
+    uint64_t state_update_cycle;
+    cp_vector_t path;            // Critical path to the latest event
+    cp_vector_t complete_path;   // Critical path to EXECUTED, for bypassed consumers
+} cp_node_t;
+
+// Analyze the critical path of the run
+extern bool g_critical_path;
+
+void critical_reset(void);
+void critical_fetch(const proc_inst_t* inst, uint64_t cycle);
+void critical_dispatch(const proc_inst_t* inst, uint64_t cycle);
+void critical_schedule(const proc_inst_t* inst, uint64_t cycle, schedule_stop_t prev_stop);
+void critical_fire(const proc_inst_t* inst, uint64_t cycle);
+void critical_complete(const proc_inst_t* inst, uint64_t cycle);
+void critical_state_update(const proc_inst_t* inst, uint64_t cycle);
+void print_critical_path(FILE* out, uint64_t cycle_count);
+
+#endif /* PROCSIM_CRITICAL_HPP */
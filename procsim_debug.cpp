@@ -0,0 +1,381 @@
+#include "procsim_debug.hpp"
+#include "procsim.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <strings.h>
+#include <vector>
+
+//
+// Interactive pipeline debugger (--debug). run_proc() calls debug_cycle() between
+// cycles and debug_event() for every pipeline event; the debugger decides there
+// whether to stop and read commands from stdin. Going backwards restores the latest
+// in-memory snapshot before the target cycle and re-executes from it with the event
+// log silenced, which is exact because the simulation is deterministic.
+//
+
+bool g_debug = false;
+
+enum breakpoint_kind_t
+{
+    BREAK_CYCLE,         // End of a cycle
+    BREAK_TAG,           // An event of one instruction (any event if event is -1)
+    BREAK_EVENT          // Any instruction reaching an event
+};
+
+typedef struct _breakpoint_t
+{
+    breakpoint_kind_t kind;
+    uint64_t value;      // Cycle or tag
+    int event;           // pipeline_event_t, or -1
+} breakpoint_t;
+
+typedef struct _snapshot_t
+{
+    uint64_t cycle;
+    std::vector<char> state;
+} snapshot_t;
+
+static std::vector<breakpoint_t> breakpoints;
+static std::vector<snapshot_t> snapshots;    // Ordered by cycle
+static uint64_t snapshot_interval = DEFAULT_DEBUG_INTERVAL;
+
+static bool started = false;       // Stopped at least once (the run stops before its first cycle)
+static bool detached = false;      // stdin ended; the run continues without stopping
+static bool replaying = false;     // Re-executing from a snapshot towards stop_cycle
+static bool saved_print_events;
+static bool saved_print_progress;
+static uint64_t stop_cycle = 0;    // Stop between cycles once this many have run
+static bool stop_pending = false;  // A breakpoint hit during the current cycle
+static char stop_reason[128];
+
+static void print_debug_help(void)
+{
+    printf("  step [N]            s   Run N cycles (default 1)\n");
+    printf("  continue            c   Run to the next breakpoint, or finish the run\n");
+    printf("  reverse-step [N]    rs  Go back N cycles (default 1)\n");
+    printf("  goto N                  Go forwards or backwards to the end of cycle N\n");
+    printf("  break cycle N       b   Stop at the end of cycle N\n");
+    printf("  break tag T [EVENT]     Stop after the cycle instruction T reaches EVENT (default any)\n");
+    printf("  break event EVENT       Stop after a cycle in which any instruction reaches EVENT\n");
+    printf("  delete [N]          d   Delete breakpoint N, or all of them\n");
+    printf("  info                i   List breakpoints and snapshots\n");
+    printf("  print WHAT          p   fetch, dq [N] (first N, default 16), rs, fu, sb (scoreboard),\n");
+    printf("                          inst T, stats\n");
+    printf("  quit                q   Exit without finishing the run\n");
+    printf("  EVENT is fetched, dispatched, scheduled, executed or state (update); prefixes work.\n");
+}
+
+/**
+ * Event a command argument abbreviates, or -1.
+ */
+static int find_event(const char* word)
+{
+    size_t len = strlen(word);
+    for (int i = 0; len > 0 && i < NUM_PIPELINE_EVENTS; i++) {
+        if (strncasecmp(g_event_names[i], word, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void print_breakpoint(size_t i)
+{
+    const breakpoint_t* bp = &breakpoints[i];
+    switch (bp->kind) {
+    case BREAK_CYCLE:
+        printf("%zu: cycle %" PRIu64 "\n", i + 1, bp->value);
+        break;
+    case BREAK_TAG:
+        printf("%zu: instruction %" PRIu64 " %s\n", i + 1, bp->value, bp->event >= 0 ? g_event_names[bp->event] : "(any event)");
+        break;
+    case BREAK_EVENT:
+        printf("%zu: any instruction %s\n", i + 1, g_event_names[bp->event]);
+        break;
+    }
+}
+
+static void take_debug_snapshot(uint64_t cycle)
+{
+    if (snapshots.size() == DEBUG_MAX_SNAPSHOTS) {
+        // Keep every other snapshot and take them half as often from now on
+        size_t n = 0;
+        for (size_t i = 0; i < snapshots.size(); i += 2) {
+            snapshots[n].cycle = snapshots[i].cycle;
+            snapshots[n++].state.swap(snapshots[i].state);
+        }
+        snapshots.resize(n);
+        snapshot_interval *= 2;
+    }
+
+    snapshot_t snap;
+    snap.cycle = cycle;
+    snapshots.push_back(snap);
+    if (!save_snapshot(snapshots.back().state)) {
+        fprintf(stderr, "Failed to snapshot cycle %" PRIu64 "\n", cycle);
+        snapshots.pop_back();
+    }
+}
+
+/**
+ * Restores the latest snapshot at or before target. Returns the cycle the engine is at now;
+ * if that is short of target, the run re-executes silently up to it before stopping.
+ */
+static uint64_t rewind_to(uint64_t target)
+{
+    size_t i = snapshots.size();
+    while (i > 0 && snapshots[i - 1].cycle > target) {
+        i--;
+    }
+    if (i == 0) {
+        // Nothing that early (e.g. the run was resumed from a checkpoint)
+        i = 1;
+        target = snapshots[0].cycle;
+        printf("Earliest snapshot is cycle %" PRIu64 "\n", target);
+    }
+
+    const snapshot_t* snap = &snapshots[i - 1];
+    if (!restore_snapshot(snap->state)) {
+        fprintf(stderr, "Failed to restore the snapshot of cycle %" PRIu64 "\n", snap->cycle);
+        exit(1);
+    }
+    if (snap->cycle < target) {
+        replaying = true;
+        saved_print_events = g_print_events;
+        saved_print_progress = g_print_progress;
+        g_print_events = false;
+        g_print_progress = false;
+    }
+    stop_cycle = target;
+    return snap->cycle;
+}
+
+static bool parse_count(const char* arg, uint64_t* p_value)
+{
+    char* end;
+    if (arg == NULL) {
+        return false;
+    }
+    *p_value = strtoull(arg, &end, 10);
+    return end != arg && *end == '\0';
+}
+
+static void add_breakpoint(char** args, int argc)
+{
+    breakpoint_t bp;
+    memset(&bp, 0, sizeof(bp));
+    bp.event = -1;
+    const char* what = argc > 1 ? args[1] : "";
+
+    if (strcmp(what, "cycle") == 0 && argc == 3 && parse_count(args[2], &bp.value)) {
+        bp.kind = BREAK_CYCLE;
+    } else if (strcmp(what, "tag") == 0 && (argc == 3 || argc == 4) && parse_count(args[2], &bp.value) &&
+               (argc == 3 || (bp.event = find_event(args[3])) >= 0)) {
+        bp.kind = BREAK_TAG;
+    } else if (strcmp(what, "event") == 0 && argc == 3 && (bp.event = find_event(args[2])) >= 0) {
+        bp.kind = BREAK_EVENT;
+    } else {
+        printf("Usage: break cycle N | break tag T [EVENT] | break event EVENT\n");
+        return;
+    }
+    breakpoints.push_back(bp);
+    printf("Breakpoint ");
+    print_breakpoint(breakpoints.size() - 1);
+}
+
+static void print_state(char** args, int argc)
+{
+    const char* what = argc > 1 ? args[1] : "";
+    uint64_t n;
+
+    if (strcmp(what, "fetch") == 0) {
+        print_fetch_buffer(stdout);
+    } else if (strcmp(what, "dq") == 0) {
+        print_dispatch_queue(stdout, parse_count(argc > 2 ? args[2] : NULL, &n) ? n : 16);
+    } else if (strcmp(what, "rs") == 0) {
+        print_reservation_station(stdout);
+    } else if (strcmp(what, "fu") == 0) {
+        print_fu_state(stdout);
+    } else if (strcmp(what, "sb") == 0) {
+        print_scoreboard(stdout);
+    } else if (strcmp(what, "inst") == 0 && parse_count(argc > 2 ? args[2] : NULL, &n)) {
+        print_instruction(stdout, n);
+    } else if (strcmp(what, "stats") == 0) {
+        fflush(stdout);
+        print_stats_snapshot();
+    } else {
+        printf("Usage: print fetch | dq [N] | rs | fu | sb | inst T | stats\n");
+    }
+}
+
+static bool is_command(const char* cmd, const char* name, const char* alias)
+{
+    return strcmp(cmd, name) == 0 || (alias != NULL && strcmp(cmd, alias) == 0);
+}
+
+/**
+ * Reads commands until one resumes the run. Returns true if the engine state was rewound.
+ */
+static bool run_commands(uint64_t cycle, bool finished)
+{
+    bool rewound = false;
+
+    if (stop_reason[0] != '\0') {
+        printf("%s\n", stop_reason);
+        stop_reason[0] = '\0';
+    }
+    printf("Cycle %" PRIu64 "%s\n", cycle, finished ? " (run finished, continue prints the stats)" : "");
+
+    char line[256];
+    for (;;) {
+        printf("(procsim) ");
+        fflush(stdout);
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            printf("\nEnd of input, running to the end\n");
+            detached = true;
+            return rewound;
+        }
+
+        char* args[4];
+        int argc = 0;
+        for (char* tok = strtok(line, " \t\r\n"); tok != NULL && argc < 4; tok = strtok(NULL, " \t\r\n")) {
+            args[argc++] = tok;
+        }
+        if (argc == 0) {
+            continue;
+        }
+        const char* cmd = args[0];
+        uint64_t n = 1;
+        if (argc > 1 && !parse_count(args[1], &n) && !is_command(cmd, "break", "b") &&
+            !is_command(cmd, "print", "p")) {
+            printf("Bad count %s\n", args[1]);
+            continue;
+        }
+
+        if (is_command(cmd, "step", "s") || (is_command(cmd, "goto", NULL) && argc == 2 && n > cycle)) {
+            uint64_t target = is_command(cmd, "goto", NULL) ? n : cycle + (n > 0 ? n : 1);
+            if (finished) {
+                printf("The run finished at cycle %" PRIu64 "\n", cycle);
+                continue;
+            }
+            stop_cycle = target;
+            return rewound;
+        } else if (is_command(cmd, "continue", "c")) {
+            stop_cycle = UINT64_MAX;
+            return rewound;
+        } else if (is_command(cmd, "reverse-step", "rs") || is_command(cmd, "goto", NULL)) {
+            uint64_t target = is_command(cmd, "goto", NULL) ? n : cycle - (n < cycle ? n : cycle);
+            if (argc != 2 && is_command(cmd, "goto", NULL)) {
+                printf("Usage: goto N\n");
+                continue;
+            }
+            if (target == cycle) {
+                printf("Cycle %" PRIu64 "\n", cycle);
+                continue;
+            }
+            rewound = true;
+            finished = false;
+            cycle = rewind_to(target);
+            if (cycle < stop_cycle) {
+                return rewound;
+            }
+            printf("Cycle %" PRIu64 "\n", cycle);
+        } else if (is_command(cmd, "break", "b")) {
+            add_breakpoint(args, argc);
+        } else if (is_command(cmd, "delete", "d")) {
+            if (argc == 1) {
+                breakpoints.clear();
+            } else if (n >= 1 && n <= breakpoints.size()) {
+                breakpoints.erase(breakpoints.begin() + (n - 1));
+            } else {
+                printf("No breakpoint %" PRIu64 "\n", n);
+            }
+        } else if (is_command(cmd, "info", "i")) {
+            for (size_t i = 0; i < breakpoints.size(); i++) {
+                print_breakpoint(i);
+            }
+            size_t bytes = 0;
+            for (size_t i = 0; i < snapshots.size(); i++) {
+                bytes += snapshots[i].state.size();
+            }
+            printf("%zu snapshots from cycle %" PRIu64 ", every %" PRIu64 " cycles (%zu MB)\n",
+                   snapshots.size(), snapshots.empty() ? 0 : snapshots[0].cycle, snapshot_interval, bytes >> 20);
+        } else if (is_command(cmd, "print", "p")) {
+            print_state(args, argc);
+        } else if (is_command(cmd, "quit", "q")) {
+            exit(0);
+        } else if (is_command(cmd, "help", "h")) {
+            print_debug_help();
+        } else {
+            printf("Unknown command %s (help lists them)\n", cmd);
+        }
+    }
+}
+
+/**
+ * Called between cycles, with `cycle` cycles run so far.
+ */
+void debug_cycle(uint64_t cycle)
+{
+    if (detached) {
+        return;
+    }
+    if (snapshots.empty() || cycle >= snapshots.back().cycle + snapshot_interval) {
+        take_debug_snapshot(cycle);
+    }
+
+    if (replaying) {
+        if (cycle < stop_cycle) {
+            return;
+        }
+        replaying = false;
+        g_print_events = saved_print_events;
+        g_print_progress = saved_print_progress;
+    } else {
+        for (size_t i = 0; i < breakpoints.size() && !stop_pending; i++) {
+            if (breakpoints[i].kind == BREAK_CYCLE && breakpoints[i].value == cycle) {
+                snprintf(stop_reason, sizeof(stop_reason), "Breakpoint %zu: cycle %" PRIu64, i + 1, cycle);
+                stop_pending = true;
+            }
+        }
+        if (started && cycle != stop_cycle && !stop_pending) {
+            return;
+        }
+    }
+
+    started = true;
+    stop_pending = false;
+    run_commands(cycle, false);
+}
+
+void debug_event(int event, uint64_t tag, uint64_t cycle)
+{
+    if (replaying || detached || stop_pending) {
+        return;
+    }
+    for (size_t i = 0; i < breakpoints.size(); i++) {
+        const breakpoint_t* bp = &breakpoints[i];
+        bool hit = bp->kind == BREAK_TAG ? bp->value == tag && (bp->event < 0 || bp->event == event) :
+                   bp->kind == BREAK_EVENT ? bp->event == event : false;
+        if (hit) {
+            snprintf(stop_reason, sizeof(stop_reason), "Breakpoint %zu: cycle %" PRIu64 " %s %" PRIu64,
+                     i + 1, cycle, g_event_names[event], tag);
+            stop_pending = true;
+            return;
+        }
+    }
+}
+
+/**
+ * Called once the pipeline has drained. Returns true if the run was rewound and goes on.
+ */
+bool debug_finished(uint64_t cycle)
+{
+    if (detached) {
+        return false;
+    }
+    stop_pending = false;
+    return run_commands(cycle, true);
+}
@@ -0,0 +1,18 @@
+#ifndef PROCSIM_DEBUG_HPP
+#define PROCSIM_DEBUG_HPP
+
+#include <cstdint>
+
+// Cycles between the in-memory snapshots reverse stepping restarts from; the interval
+// doubles whenever DEBUG_MAX_SNAPSHOTS are held
+#define DEFAULT_DEBUG_INTERVAL 1000
+#define DEBUG_MAX_SNAPSHOTS 32
+
+// Stop the run in the interactive debugger (requires a memory or synthetic trace)
+extern bool g_debug;
+
+void debug_cycle(uint64_t cycle);
+void debug_event(int event, uint64_t tag, uint64_t cycle);
+bool debug_finished(uint64_t cycle);
+
+#endif /* PROCSIM_DEBUG_HPP */
@@ -0,0 +1,333 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//
+// procsim-diff: compares two procsim event logs or timing tables (the INST FETCH DISP
+// SCHED EXEC STATE rows of *.output). Identical files are confirmed with block memcmp
+// over the mapped files; otherwise it reports the first diverging line with its cycle
+// and instruction, some context, and how many instructions differ anywhere.
+//
+
+#define DIFF_BLOCK (1 << 16)
+#define NUM_FIELDS 5   // FETCH DISP SCHED EXEC STATE
+
+typedef struct _mapped_file_t
+{
+    const char* path;
+    const char* data;
+    size_t size;
+} mapped_file_t;
+
+typedef struct _inst_row_t
+{
+    uint64_t cycle[NUM_FIELDS];   // 0 = not in the file
+} inst_row_t;
+
+// Rows of one file, rows[i] holding tag base + i. Each file has its own base, so a run
+// numbered from --first-tag compares against a normal one without rows for the gap.
+typedef struct _tag_rows_t
+{
+    uint64_t base;
+    std::vector<inst_row_t> rows;
+} tag_rows_t;
+
+void print_help_and_exit(void) {
+    printf("procsim-diff [OPTIONS] A B\n");
+    printf("  -C N\t\tLines of context around the first divergence (default 3)\n");
+    printf("  -h\t\tThis helpful output\n");
+    printf("Exit status is 0 if the files are identical, 1 if they differ, 2 on error.\n");
+    exit(0);
+}
+
+static bool map_file(const char* path, mapped_file_t* f)
+{
+    f->path = path;
+    f->data = "";
+    f->size = 0;
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+    f->size = st.st_size;
+    if (f->size > 0) {
+        f->data = (const char*)mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (f->data == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return false;
+        }
+        madvise((void*)f->data, f->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    return true;
+}
+
+/**
+ * Offset of the first byte where a and b differ, compared a block at a time.
+ */
+static size_t first_difference(const mapped_file_t* a, const mapped_file_t* b)
+{
+    size_t n = std::min(a->size, b->size);
+    size_t off = 0;
+    while (off < n) {
+        size_t len = std::min((size_t)DIFF_BLOCK, n - off);
+        if (memcmp(a->data + off, b->data + off, len) != 0) {
+            while (a->data[off] == b->data[off]) {
+                off++;
+            }
+            return off;
+        }
+        off += len;
+    }
+    return n;
+}
+
+static size_t line_end(const mapped_file_t* f, size_t off)
+{
+    const char* nl = (const char*)memchr(f->data + off, '\n', f->size - off);
+    return nl ? nl - f->data : f->size;
+}
+
+static uint64_t parse_number(const char** p, const char* end, bool* ok)
+{
+    uint64_t v = 0;
+    const char* start = *p;
+    while (*p < end && **p >= '0' && **p <= '9') {
+        v = v * 10 + (*(*p)++ - '0');
+    }
+    *ok = *p > start;
+    return v;
+}
+
+/**
+ * Decodes one line: an event "CYCLE\tOPERATION\tTAG" sets one field of the row, a table
+ * row "INST\tFETCH\tDISP\tSCHED\tEXEC\tSTATE" sets all of them. Returns false for other
+ * lines. *p_cycle is the earliest cycle the line mentions.
+ */
+static bool parse_line(const char* p, const char* end, uint64_t* p_tag, uint64_t* p_cycle,
+                       int* p_field, uint64_t* values)
+{
+    bool ok;
+    uint64_t first = parse_number(&p, end, &ok);
+    if (!ok || p >= end || *p != '\t') {
+        return false;
+    }
+    p++;
+
+    if (*p >= 'A' && *p <= 'Z') {
+        const char* word = p;
+        while (p < end && *p != '\t') {
+            p++;
+        }
+        int field = -1;
+        switch (word[0]) {
+        case 'F': field = 0; break;
+        case 'D': field = 1; break;
+        case 'E': field = 3; break;
+        case 'S': field = word[1] == 'C' ? 2 : word[1] == 'T' ? 4 : -1; break;
+        }
+        if (field < 0 || p >= end) {
+            return false;
+        }
+        p++;
+        *p_tag = parse_number(&p, end, &ok);
+        *p_cycle = first;
+        *p_field = field;
+        values[0] = first;
+        return ok && *p_tag > 0 && p == end;
+    }
+
+    *p_tag = first;
+    *p_field = -1;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        values[i] = parse_number(&p, end, &ok);
+        if (!ok || (i < NUM_FIELDS - 1 && (p >= end || *p++ != '\t'))) {
+            return false;
+        }
+    }
+    *p_cycle = *std::min_element(values, values + NUM_FIELDS);
+    return p == end && *p_tag > 0;
+}
+
+static void load_rows(const mapped_file_t* f, tag_rows_t* t)
+{
+    std::vector<inst_row_t>& rows = t->rows;
+    inst_row_t empty;
+    memset(&empty, 0, sizeof(empty));
+    size_t off = 0;
+    while (off < f->size) {
+        size_t end = line_end(f, off);
+        uint64_t tag, cycle, values[NUM_FIELDS];
+        int field;
+        if (parse_line(f->data + off, f->data + end, &tag, &cycle, &field, values)) {
+            // The first instruction fetched normally has the smallest tag
+            if (rows.empty()) {
+                t->base = tag;
+            } else if (tag < t->base) {
+                rows.insert(rows.begin(), t->base - tag, empty);
+                t->base = tag;
+            }
+            uint64_t i = tag - t->base;
+            if (i >= rows.size()) {
+                rows.resize(std::max((size_t)i + 1, rows.size() * 2), empty);
+            }
+            if (field < 0) {
+                memcpy(rows[i].cycle, values, sizeof(values));
+            } else {
+                rows[i].cycle[field] = values[0];
+            }
+        }
+        off = end + 1;
+    }
+}
+
+/**
+ * The row of tag in t, or NULL if the file has none.
+ */
+static const inst_row_t* row_at(const tag_rows_t* t, uint64_t tag)
+{
+    static const inst_row_t empty = {};
+    if (tag < t->base || tag - t->base >= t->rows.size()) {
+        return NULL;
+    }
+    const inst_row_t* r = &t->rows[tag - t->base];
+    return memcmp(r, &empty, sizeof(empty)) != 0 ? r : NULL;
+}
+
+/**
+ * Start offsets of the `n` lines before the line starting at off.
+ */
+static size_t lines_back(const mapped_file_t* f, size_t off, int n)
+{
+    while (n-- > 0 && off > 0) {
+        off--;
+        while (off > 0 && f->data[off - 1] != '\n') {
+            off--;
+        }
+    }
+    return off;
+}
+
+static void print_lines(const mapped_file_t* f, size_t off, size_t stop, int max,
+                        const char* prefix, uint64_t line)
+{
+    for (int i = 0; off < stop && off < f->size && i < max; i++) {
+        size_t end = line_end(f, off);
+        printf("%s%8" PRIu64 "  %.*s\n", prefix, line++, (int)(end - off), f->data + off);
+        off = end + 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    int context = 3;
+
+    while(-1 != (opt = getopt(argc, argv, "C:h"))) {
+        switch(opt) {
+        case 'C':
+            context = atoi(optarg);
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+    if (optind != argc - 2) {
+        print_help_and_exit();
+    }
+
+    mapped_file_t a, b;
+    if (!map_file(argv[optind], &a) || !map_file(argv[optind + 1], &b)) {
+        return 2;
+    }
+
+    size_t diff = first_difference(&a, &b);
+    if (diff == a.size && a.size == b.size) {
+        return 0;
+    }
+
+    // Back up to the start of the diverging line
+    size_t start = diff;
+    while (start > 0 && a.data[start - 1] != '\n') {
+        start--;
+    }
+    uint64_t line = 1;
+    for (const char* p = a.data; (p = (const char*)memchr(p, '\n', a.data + start - p)) != NULL; p++) {
+        line++;
+    }
+
+    printf("%s and %s differ at line %" PRIu64 "\n", a.path, b.path, line);
+
+    uint64_t tag_a = 0, tag_b = 0, cycle_a = 0, cycle_b = 0;
+    uint64_t values_a[NUM_FIELDS], values_b[NUM_FIELDS];
+    int field_a, field_b;
+    bool ev_a = start < a.size && parse_line(a.data + start, a.data + line_end(&a, start),
+                                             &tag_a, &cycle_a, &field_a, values_a);
+    bool ev_b = start < b.size && parse_line(b.data + start, b.data + line_end(&b, start),
+                                             &tag_b, &cycle_b, &field_b, values_b);
+    if (ev_a || ev_b) {
+        uint64_t cycle = ev_a && ev_b ? std::min(cycle_a, cycle_b) : ev_a ? cycle_a : cycle_b;
+        if (ev_a && ev_b && field_a < 0 && field_b < 0 && tag_a == tag_b) {
+            // Same table row: the first stage whose cycle differs
+            for (int i = 0; i < NUM_FIELDS; i++) {
+                if (values_a[i] != values_b[i]) {
+                    cycle = std::min(values_a[i], values_b[i]);
+                    break;
+                }
+            }
+        }
+        printf("First divergence: cycle %" PRIu64 ", instruction %" PRIu64, cycle, ev_a ? tag_a : tag_b);
+        if (ev_a && ev_b && tag_a != tag_b) {
+            printf(" (%" PRIu64 " in %s)", tag_b, b.path);
+        }
+        printf("\n");
+    }
+
+    size_t before = lines_back(&a, start, context);
+    uint64_t before_line = line;
+    for (size_t off = before; off < start; off = line_end(&a, off) + 1) {
+        before_line--;
+    }
+    printf("\n");
+    print_lines(&a, before, start, context, "  ", before_line);
+    print_lines(&a, start, a.size, context + 1, "- ", line);
+    print_lines(&b, start, b.size, context + 1, "+ ", line);
+    printf("\n");
+
+    tag_rows_t rows_a, rows_b;
+    load_rows(&a, &rows_a);
+    load_rows(&b, &rows_b);
+
+    // Instructions of A, then those only B has
+    uint64_t total = 0, divergent = 0;
+    for (size_t i = 0; i < rows_a.rows.size(); i++) {
+        const inst_row_t* ra = row_at(&rows_a, rows_a.base + i);
+        if (ra != NULL) {
+            const inst_row_t* rb = row_at(&rows_b, rows_a.base + i);
+            total++;
+            divergent += rb == NULL || memcmp(ra, rb, sizeof(inst_row_t)) != 0;
+        }
+    }
+    for (size_t i = 0; i < rows_b.rows.size(); i++) {
+        if (row_at(&rows_b, rows_b.base + i) != NULL && row_at(&rows_a, rows_b.base + i) == NULL) {
+            total++;
+            divergent++;
+        }
+    }
+    printf("Divergent instructions: %" PRIu64 " of %" PRIu64 "\n", divergent, total);
+
+    return 1;
+}
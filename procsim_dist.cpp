@@ -0,0 +1,490 @@
+#include "procsim_dist.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+enum dist_job_state_t
+{
+    JOB_PENDING,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED
+};
+
+typedef struct _dist_job_t
+{
+    std::string trace;
+    sweep_config_t config;
+    dist_job_state_t state;
+    int attempts;
+    int owner;           // Client fd currently running the job
+    uint64_t deadline;   // Monotonic ms after which a running job is handed out again
+} dist_job_t;
+
+typedef struct _dist_client_t
+{
+    int fd;
+    std::string pending;  // Bytes received but not yet terminated by a newline
+} dist_client_t;
+
+void print_sweep_header(FILE* out)
+{
+    fprintf(out, "trace,R,k0,k1,k2,F,retired,cycles,avg_retired,avg_fired,avg_disp,max_disp\n");
+}
+
+void print_sweep_row(FILE* out, const char* trace, const sweep_config_t* p_cfg,
+                     const proc_stats_t* p_stats)
+{
+    fprintf(out, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%f,%f,%f,%" PRIu64 "\n",
+            trace, p_cfg->r, p_cfg->k0, p_cfg->k1, p_cfg->k2, p_cfg->f,
+            p_stats->retired_instruction, p_stats->cycle_count, p_stats->avg_inst_retired,
+            p_stats->avg_inst_fired, p_stats->avg_disp_size, p_stats->max_disp_size);
+    fflush(out);
+}
+
+/**
+ * Opens a listening (server) or connected (client) socket for "unix:/path" or "host:port".
+ * Returns -1 and prints the reason on failure.
+ */
+static int open_socket(const char* addr, bool server)
+{
+    if (strncmp(addr, "unix:", 5) == 0) {
+        struct sockaddr_un sun;
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        if (strlen(addr + 5) >= sizeof(sun.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", addr + 5);
+            return -1;
+        }
+        strcpy(sun.sun_path, addr + 5);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            perror("socket");
+            return -1;
+        }
+        if (server) {
+            unlink(sun.sun_path);
+            if (bind(fd, (struct sockaddr*)&sun, sizeof(sun)) != 0 || listen(fd, 64) != 0) {
+                perror(addr);
+                close(fd);
+                return -1;
+            }
+        } else if (connect(fd, (struct sockaddr*)&sun, sizeof(sun)) != 0) {
+            perror(addr);
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    const char* colon = strrchr(addr, ':');
+    if (colon == NULL) {
+        fprintf(stderr, "Expected unix:/path or host:port, got %s\n", addr);
+        return -1;
+    }
+    std::string host(addr, colon - addr);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = server ? AI_PASSIVE : 0;
+
+    struct addrinfo* res;
+    int err = getaddrinfo(host.empty() ? NULL : host.c_str(), colon + 1, &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "%s: %s\n", addr, gai_strerror(err));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (server) {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 64) == 0) {
+                break;
+            }
+        } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        fprintf(stderr, "Could not %s %s\n", server ? "listen on" : "connect to", addr);
+    }
+    return fd;
+}
+
+static bool send_line(int fd, const std::string& line)
+{
+    const char* p = line.c_str();
+    size_t left = line.size();
+    while (left > 0) {
+        ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+/**
+ * Reads "trace R k0 k1 k2 F" lines. Duplicate (trace, config) entries are merged.
+ */
+static bool load_jobs(const char* path, std::vector<dist_job_t>& jobs)
+{
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+
+    std::map<std::string, size_t> seen;
+    char line[4096];
+    char trace[4096];
+    unsigned line_no = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        dist_job_t job;
+        sweep_config_t* c = &job.config;
+        if (sscanf(line, "%4095s %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                   trace, &c->r, &c->k0, &c->k1, &c->k2, &c->f) != 6) {
+            fprintf(stderr, "%s:%u: expected 'trace R k0 k1 k2 F'\n", path, line_no);
+            fclose(in);
+            return false;
+        }
+
+        char key[4200];
+        snprintf(key, sizeof(key), "%s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64,
+                 trace, c->r, c->k0, c->k1, c->k2, c->f);
+        if (seen.count(key)) {
+            continue;
+        }
+        seen[key] = jobs.size();
+
+        job.trace = trace;
+        job.state = JOB_PENDING;
+        job.attempts = 0;
+        job.owner = -1;
+        job.deadline = 0;
+        jobs.push_back(job);
+    }
+
+    fclose(in);
+    return true;
+}
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void requeue_job(dist_job_t* p_job, int max_retries)
+{
+    p_job->owner = -1;
+    if (p_job->attempts > max_retries) {
+        p_job->state = JOB_FAILED;
+        fprintf(stderr, "Giving up on %s R=%" PRIu64 " k0=%" PRIu64 " k1=%" PRIu64 " k2=%" PRIu64 " F=%" PRIu64 "\n",
+                p_job->trace.c_str(), p_job->config.r, p_job->config.k0, p_job->config.k1,
+                p_job->config.k2, p_job->config.f);
+    } else {
+        p_job->state = JOB_PENDING;
+    }
+}
+
+/**
+ * Handles one request line from a worker. Returns false if the client should be dropped.
+ */
+static bool handle_request(dist_client_t* p_client, const std::string& line,
+                           std::vector<dist_job_t>& jobs, int max_retries, uint64_t job_timeout)
+{
+    char reply[4200];
+
+    if (line == "GET") {
+        bool any_running = false;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            dist_job_t* p_job = &jobs[i];
+            if (p_job->state == JOB_PENDING) {
+                p_job->state = JOB_RUNNING;
+                p_job->owner = p_client->fd;
+                p_job->attempts++;
+                p_job->deadline = job_timeout ? monotonic_ms() + job_timeout * 1000 : 0;
+                const sweep_config_t* c = &p_job->config;
+                snprintf(reply, sizeof(reply),
+                         "JOB %zu %s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+                         i, p_job->trace.c_str(), c->r, c->k0, c->k1, c->k2, c->f);
+                return send_line(p_client->fd, reply);
+            }
+            any_running = any_running || p_job->state == JOB_RUNNING;
+        }
+        return send_line(p_client->fd, any_running ? "WAIT\n" : "DONE\n");
+    }
+
+    size_t id;
+    proc_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    if (sscanf(line.c_str(), "RESULT %zu %" SCNu64 " %" SCNu64 " %lf %lf %lf %" SCNu64, &id,
+               &stats.retired_instruction, &stats.cycle_count, &stats.avg_inst_retired,
+               &stats.avg_inst_fired, &stats.avg_disp_size, &stats.max_disp_size) == 7) {
+        if (id >= jobs.size()) {
+            return false;
+        }
+        dist_job_t* p_job = &jobs[id];
+        // A retried job may report twice; only the first result is kept
+        if (p_job->state != JOB_DONE) {
+            p_job->state = JOB_DONE;
+            p_job->owner = -1;
+            print_sweep_row(stdout, p_job->trace.c_str(), &p_job->config, &stats);
+        }
+        return true;
+    }
+
+    if (sscanf(line.c_str(), "FAIL %zu", &id) == 1) {
+        if (id >= jobs.size()) {
+            return false;
+        }
+        dist_job_t* p_job = &jobs[id];
+        if (p_job->state == JOB_RUNNING && p_job->owner == p_client->fd) {
+            requeue_job(p_job, max_retries);
+        }
+        return true;
+    }
+
+    fprintf(stderr, "Unexpected request: %s\n", line.c_str());
+    return false;
+}
+
+/**
+ * Serves the jobs file to connected workers and prints one CSV row per finished job.
+ * Jobs held by a worker that fails, disconnects or has not reported after job_timeout
+ * seconds (0 = no limit) are handed out again, up to max_retries. A late result from
+ * the first worker is still accepted.
+ */
+int run_coordinator(const char* addr, const char* jobs_path, int max_retries, uint64_t job_timeout)
+{
+    std::vector<dist_job_t> jobs;
+    if (!load_jobs(jobs_path, jobs)) {
+        return 1;
+    }
+
+    int listen_fd = open_socket(addr, true);
+    if (listen_fd < 0) {
+        return 1;
+    }
+
+    fprintf(stderr, "Coordinator: %zu jobs, listening on %s\n", jobs.size(), addr);
+    print_sweep_header(stdout);
+
+    std::vector<dist_client_t> clients;
+    for (;;) {
+        size_t remaining = 0;
+        uint64_t now = monotonic_ms();
+        uint64_t next_deadline = UINT64_MAX;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            dist_job_t* p_job = &jobs[i];
+            if (p_job->state == JOB_RUNNING && p_job->deadline != 0) {
+                if (now >= p_job->deadline) {
+                    fprintf(stderr, "Job %zu timed out on its worker, handing it out again\n", i);
+                    requeue_job(p_job, max_retries);
+                } else {
+                    next_deadline = std::min(next_deadline, p_job->deadline);
+                }
+            }
+            if (p_job->state == JOB_PENDING || p_job->state == JOB_RUNNING) {
+                remaining++;
+            }
+        }
+        if (remaining == 0) {
+            break;
+        }
+
+        std::vector<struct pollfd> fds(clients.size() + 1);
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < clients.size(); i++) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+
+        int wait_ms = next_deadline == UINT64_MAX ? -1 : (int)std::min<uint64_t>(next_deadline - now, INT32_MAX);
+        if (poll(&fds[0], fds.size(), wait_ms) < 0) {
+            perror("poll");
+            break;
+        }
+
+        // Walk clients backwards so dropping one does not shift unvisited entries
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (fds[i + 1].revents == 0) {
+                continue;
+            }
+
+            dist_client_t* p_client = &clients[i];
+            char buf[4096];
+            ssize_t n = recv(p_client->fd, buf, sizeof(buf), 0);
+            bool keep = n > 0;
+            if (keep) {
+                p_client->pending.append(buf, n);
+                size_t nl;
+                while (keep && (nl = p_client->pending.find('\n')) != std::string::npos) {
+                    std::string line = p_client->pending.substr(0, nl);
+                    p_client->pending.erase(0, nl + 1);
+                    keep = handle_request(p_client, line, jobs, max_retries, job_timeout);
+                }
+            }
+
+            if (!keep) {
+                for (size_t j = 0; j < jobs.size(); j++) {
+                    if (jobs[j].state == JOB_RUNNING && jobs[j].owner == p_client->fd) {
+                        requeue_job(&jobs[j], max_retries);
+                    }
+                }
+                close(p_client->fd);
+                clients.erase(clients.begin() + i);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                dist_client_t client;
+                client.fd = fd;
+                clients.push_back(client);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < clients.size(); i++) {
+        send_line(clients[i].fd, "DONE\n");
+        close(clients[i].fd);
+    }
+    close(listen_fd);
+    if (strncmp(addr, "unix:", 5) == 0) {
+        unlink(addr + 5);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        failed += jobs[i].state == JOB_FAILED;
+    }
+    fprintf(stderr, "Coordinator: %zu jobs done, %zu failed\n", jobs.size() - failed, failed);
+    return failed == 0 ? 0 : 1;
+}
+
+/**
+ * Pulls jobs over one connection until the coordinator says DONE or goes away.
+ */
+static int worker_loop(const char* addr)
+{
+    int fd = open_socket(addr, false);
+    if (fd < 0) {
+        return 1;
+    }
+    FILE* in = fdopen(dup(fd), "r");
+
+    char line[4200];
+    char trace[4096];
+    for (;;) {
+        if (!send_line(fd, "GET\n") || fgets(line, sizeof(line), in) == NULL) {
+            break;
+        }
+
+        sweep_job_t job;
+        memset(&job, 0, sizeof(job));
+        sweep_config_t* c = &job.config;
+        size_t id;
+        if (sscanf(line, "JOB %zu %4095s %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                   &id, trace, &c->r, &c->k0, &c->k1, &c->k2, &c->f) == 7) {
+            char reply[512];
+            if (run_job(trace, &job)) {
+                const proc_stats_t* s = &job.stats;
+                snprintf(reply, sizeof(reply), "RESULT %zu %" PRIu64 " %" PRIu64 " %.17g %.17g %.17g %" PRIu64 "\n", id,
+                         s->retired_instruction, s->cycle_count, s->avg_inst_retired,
+                         s->avg_inst_fired, s->avg_disp_size, s->max_disp_size);
+            } else {
+                snprintf(reply, sizeof(reply), "FAIL %zu\n", id);
+            }
+            if (!send_line(fd, reply)) {
+                break;
+            }
+        } else if (strncmp(line, "WAIT", 4) == 0) {
+            sleep(1);
+        } else {
+            break;
+        }
+    }
+
+    fclose(in);
+    close(fd);
+    return 0;
+}
+
+/**
+ * Runs `workers` independent connections to the coordinator, one process each.
+ */
+int run_worker(const char* addr, int workers)
+{
+    if (workers <= 0) {
+        workers = default_worker_count();
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    if (g_pin_workers) {
+        load_cpu_topology();
+    }
+
+    std::vector<pid_t> pids;
+    for (int i = 0; i < workers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            if (g_pin_workers) {
+                pin_worker(i);
+            }
+            _exit(worker_loop(addr));
+        }
+        if (pid > 0) {
+            pids.push_back(pid);
+        }
+    }
+
+    int rc = 0;
+    for (size_t i = 0; i < pids.size(); i++) {
+        int status;
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            rc = 1;
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,19 @@
+#ifndef PROCSIM_DIST_HPP
+#define PROCSIM_DIST_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include "procsim_sweep.hpp"
+
+#define DEFAULT_DIST_RETRIES 3
+#define DEFAULT_DIST_JOB_TIMEOUT 3600
+
+// Addresses are "unix:/path/to/socket" or "host:port" (TCP).
+int run_coordinator(const char* addr, const char* jobs_path, int max_retries, uint64_t job_timeout);
+int run_worker(const char* addr, int workers);
+
+void print_sweep_header(FILE* out);
+void print_sweep_row(FILE* out, const char* trace, const sweep_config_t* p_cfg,
+                     const proc_stats_t* p_stats);
+
+#endif /* PROCSIM_DIST_HPP */
@@ -3,9 +3,29 @@
 #include <cstdlib>
 #include <cstring>
 #include <unistd.h>
+#include <getopt.h>
+#include <vector>
+#include <utility>
 #include "procsim.hpp"
+#include "procsim_sweep.hpp"
+#include "procsim_dist.hpp"
+#include "procsim_live.hpp"
+#include "procsim_hotspot.hpp"
+#include "procsim_energy.hpp"
+#include "procsim_report.hpp"
+#include "procsim_trace.hpp"
+#include "procsim_debug.hpp"
+#include "procsim_flight.hpp"
+#include "procsim_critical.hpp"
+#include "procsim_occupancy.hpp"
 
 FILE* inFile = stdin;
+const char* inPath = NULL;
+
+// --synthetic: generated instruction stream used instead of inFile
+bool synthetic = false;
+uint64_t synthetic_count = 0;
+bool preload = false;
 
 void print_help_and_exit(void) {
     printf("procsim [OPTIONS]\n");
@@ -15,35 +35,297 @@ void print_help_and_exit(void) {
     printf("  -f N\t\tNumber of instructions to fetch\n");
     printf("  -r R\t\tNumber of result buses\n");
     printf("  -i traces/file.trace\n");
+    printf("  --synthetic N\tSimulate N generated instructions instead of a trace\n");
+    printf("  --preload\tDecode the whole trace into huge-page backed memory before simulating\n");
+    printf("  --parse-threads N\tThreads parsing a text trace file (default: online cores, 1 = on the fetching thread)\n");
+    printf("  --quiet\tDo not print the per-instruction event log\n");
     printf("  -h\t\tThis helpful output\n");
+    printf("\n");
+    printf("  --tune\t\tSearch k0/k1/k2/R for the IPC vs cost Pareto frontier (requires -i)\n");
+    printf("  --cost A,B\tTuning/report cost = A*(k0+k1+k2) + B*R (default 1,1)\n");
+    printf("  --tune-max-fu N\tLargest k0/k1/k2 searched (default %d)\n", DEFAULT_TUNE_MAX_FU);
+    printf("  --tune-max-r N\tLargest R searched (default %d)\n", DEFAULT_TUNE_MAX_R);
+    printf("  --sample N\tInstructions per sampled pruning run (default %d)\n", DEFAULT_TUNE_SAMPLE);
+    printf("  --margin X\tRelative IPC slack kept when pruning (default %.2f)\n", DEFAULT_TUNE_MARGIN);
+    printf("  --jobs N\tConcurrent simulations (default: online cores)\n");
+    printf("  --serve ADDR\tCoordinate a distributed sweep on unix:/path or host:port\n");
+    printf("  --jobs-file F\tSweep jobs for --serve, one 'trace R k0 k1 k2 F' per line\n");
+    printf("  --retries N\tTimes a failed job is handed out again (default %d)\n", DEFAULT_DIST_RETRIES);
+    printf("  --job-timeout S\tSeconds before a job a worker has not reported is handed out again (default %d, 0 = never)\n", DEFAULT_DIST_JOB_TIMEOUT);
+    printf("  --worker ADDR\tPull sweep jobs from a coordinator (--jobs connections)\n");
+    printf("  --pin\t\tPin --tune/--worker processes to cores, one trace copy per NUMA node\n");
+    printf("  --report CSV\tSensitivity, Pareto and diminishing-returns report of sweep rows (- = stdin)\n");
+    printf("  --knee X\tReport knee threshold relative to the first step's gain (default %.2f)\n", DEFAULT_REPORT_KNEE);
+    printf("  --live NAME\tPublish live counters to shared memory NAME for procsim-top\n");
+    printf("  --fu-config F\tFU classes and opcode map (replaces -j/-k/-l, see load_fu_config)\n");
+    printf("  --bypass N\tForward up to N operands per cycle from EXECUTED producers (default 0 = off)\n");
+    printf("  --dispatch-width N\tInstructions dispatched per cycle (default 0 = whole fetch buffer)\n");
+    printf("  --schedule-width N\tInstructions scheduled per cycle (default 0 = no limit)\n");
+    printf("  --clusters N\tSplit the RS and FU pools into N clusters (max %d)\n", MAX_CLUSTERS);
+    printf("  --steer P\tCluster steering: rr (round-robin, default) or dep (dependence-based)\n");
+    printf("  --xcluster-delay N\tExtra wakeup cycles for operands from another cluster (default 1)\n");
+    printf("  --policy P\tScheduling policy:\n");
+    print_sched_policies(stdout);
+    printf("  --warmup N\tReport the first N retired instructions (Nc: cycles) and the rest separately\n");
+    printf("  --roi S:E\tReport retired instructions [S, E) separately (Sc:Ec for cycles, E empty = end)\n");
+    printf("  --activity\tPrint per-structure activity counters\n");
+    printf("  --energy F\tPrint activity, energy and EDP using the per-event energies in F\n");
+    printf("  --hotspots[=N]\tPrint the N static instructions with most stall cycles (default %d)\n", DEFAULT_HOTSPOT_TOP);
+    printf("  --critical-path\tBreak the critical path of the run down by edge kind (FU, result bus, RS, ...)\n");
+    printf("  --occupancy\tPrint occupancy percentiles of the fetch buffer, DQ, RS and FU pools\n");
+    printf("  --occupancy-csv F\tWrite the full occupancy histograms to F as CSV (- = stdout)\n");
+    printf("  --debug\tStep the pipeline interactively, reading commands from stdin (requires -i or --synthetic)\n");
+    printf("  --flight-recorder N\tKeep the events of the last N cycles for a crash dump (default %d, 0 = off)\n", DEFAULT_FLIGHT_CYCLES);
+    printf("  --flight-log F\tWhere the flight recorder dumps its events (default %s)\n", DEFAULT_FLIGHT_PATH);
+    printf("  --watchdog N\tAbort, dumping the flight recorder, after N cycles without a retirement (default 0 = off)\n");
+    printf("  --first-tag N\tTag of the first instruction (default 1; tests start near the 2^32 tag wrap)\n");
+    printf("  --checkpoint F\tCheckpoint file written on SIGUSR2 (default %s)\n", DEFAULT_CHECKPOINT_PATH);
+    printf("  --resume F\tContinue from a checkpoint (same trace, config taken from F)\n");
+    printf("\n");
+    printf("  SIGUSR1 prints a statistics snapshot to stderr, SIGUSR2 writes a checkpoint.\n");
+    printf("  Fatal signals, SIGINT, SIGTERM and SIGQUIT dump the flight recorder.\n");
     exit(0);
 }
 
 //
-// read_instruction
+// parse_bound
 //
-//  returns true if an instruction was read successfully
+//  Parses a region bound "N" (retired instructions) or "Nc" (cycles).
 //
-bool read_instruction(proc_inst_t* p_inst)
+static bool parse_bound(const char* str, char** p_end, uint64_t* p_value, bool* p_cycles)
 {
-    int ret;
-    
-    if (p_inst == NULL)
-    {
-        fprintf(stderr, "Fetch requires a valid pointer to populate\n");
+    *p_value = strtoull(str, p_end, 10);
+    if (*p_end == str) {
         return false;
     }
-    
-    ret = fscanf(stdin, "%x %d %d %d %d\n", &p_inst->instruction_address,
-                 &p_inst->op_code, &p_inst->dest_reg, &p_inst->src_reg[0], &p_inst->src_reg[1]); 
-    if (ret != 5) {
+    *p_cycles = **p_end == 'c';
+    if (*p_cycles) {
+        (*p_end)++;
+    }
+    return true;
+}
+
+static void add_region(const char* name, bool in_cycles, uint64_t start, uint64_t end)
+{
+    region_t* rg = &g_regions[g_num_regions++];
+    snprintf(rg->name, sizeof(rg->name), "%s", name);
+    rg->in_cycles = in_cycles;
+    rg->start = start;
+    rg->end = end;
+}
+
+//
+// load_fu_config
+//
+//  Reads a function unit table:
+//    fu <count> <latency> <pipelined 0|1>   one line per class, in class order
+//    op <opcode> <class>                    opcode -> class mapping
+//  Opcodes without an op line map to the class with the same number, and -1 to class 1.
+//
+bool load_fu_config(const char* path, fu_class_t* classes, uint64_t* p_n, int32_t* opcode_class)
+{
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+
+    std::vector<std::pair<int, int> > ops;
+    char line[256];
+    unsigned line_no = 0;
+    *p_n = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_no++;
+        uint64_t count, latency;
+        int pipelined, op, cls;
+        char word[8];
+        if (sscanf(line, "%7s", word) != 1 || word[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, " fu %" SCNu64 " %" SCNu64 " %d", &count, &latency, &pipelined) == 3) {
+            if (count == 0 || latency == 0 || *p_n == MAX_FU_CLASSES) {
+                if (count == 0) {
+                    // Its opcodes could never fire and the run would hang
+                    fprintf(stderr, "%s:%u: an FU class needs at least one unit\n", path, line_no);
+                } else if (latency == 0) {
+                    fprintf(stderr, "%s:%u: an FU latency must be at least one cycle\n", path, line_no);
+                } else {
+                    fprintf(stderr, "%s:%u: more than %d FU classes\n", path, line_no, MAX_FU_CLASSES);
+                }
+                fclose(in);
+                return false;
+            }
+            classes[*p_n].count = count;
+            classes[*p_n].latency = latency;
+            classes[*p_n].pipelined = pipelined != 0;
+            (*p_n)++;
+        } else if (sscanf(line, " op %d %d", &op, &cls) == 2 && op >= -1 && op <= MAX_OPCODE) {
+            ops.push_back(std::make_pair(op, cls));
+        } else {
+            fprintf(stderr, "%s:%u: expected 'fu COUNT LATENCY PIPELINED' or 'op OPCODE CLASS'\n",
+                    path, line_no);
+            fclose(in);
+            return false;
+        }
+    }
+    fclose(in);
+
+    for (int i = 0; i < MAX_OPCODE + 2; i++) {
+        opcode_class[i] = (i >= 1 && (uint64_t)(i - 1) < *p_n) ? i - 1 : -1;
+    }
+    if (*p_n > 1) {
+        opcode_class[-1 + 1] = 1;
+    }
+    for (size_t i = 0; i < ops.size(); i++) {
+        if (ops[i].second < 0 || (uint64_t)ops[i].second >= *p_n) {
+            fprintf(stderr, "%s: opcode %d maps to undefined class %d\n", path, ops[i].first, ops[i].second);
+            return false;
+        }
+        opcode_class[ops[i].first + 1] = ops[i].second;
+    }
+
+    if (*p_n == 0) {
+        fprintf(stderr, "%s defines no FU classes\n", path);
         return false;
     }
-    
     return true;
 }
 
-void print_statistics(proc_stats_t* p_stats);
+void print_statistics(const char* title, proc_stats_t* p_stats);
+
+enum long_only_options
+{
+    OPT_TUNE = 256,
+    OPT_COST,
+    OPT_TUNE_MAX_FU,
+    OPT_TUNE_MAX_R,
+    OPT_SAMPLE,
+    OPT_MARGIN,
+    OPT_JOBS,
+    OPT_SERVE,
+    OPT_JOBS_FILE,
+    OPT_RETRIES,
+    OPT_JOB_TIMEOUT,
+    OPT_WORKER,
+    OPT_LIVE,
+    OPT_CHECKPOINT,
+    OPT_RESUME,
+    OPT_HOTSPOTS,
+    OPT_FU_CONFIG,
+    OPT_BYPASS,
+    OPT_DISPATCH_WIDTH,
+    OPT_SCHEDULE_WIDTH,
+    OPT_CLUSTERS,
+    OPT_STEER,
+    OPT_XCLUSTER_DELAY,
+    OPT_ACTIVITY,
+    OPT_ENERGY,
+    OPT_REPORT,
+    OPT_KNEE,
+    OPT_SYNTHETIC,
+    OPT_QUIET,
+    OPT_PRELOAD,
+    OPT_PIN,
+    OPT_POLICY,
+    OPT_WARMUP,
+    OPT_ROI,
+    OPT_DEBUG,
+    OPT_FLIGHT_RECORDER,
+    OPT_FLIGHT_LOG,
+    OPT_WATCHDOG,
+    OPT_CRITICAL_PATH,
+    OPT_OCCUPANCY,
+    OPT_OCCUPANCY_CSV,
+    OPT_PARSE_THREADS,
+    OPT_FIRST_TAG,
+};
+
+static const struct option long_options[] = {
+    { "tune",        no_argument,       NULL, OPT_TUNE },
+    { "cost",        required_argument, NULL, OPT_COST },
+    { "tune-max-fu", required_argument, NULL, OPT_TUNE_MAX_FU },
+    { "tune-max-r",  required_argument, NULL, OPT_TUNE_MAX_R },
+    { "sample",      required_argument, NULL, OPT_SAMPLE },
+    { "margin",      required_argument, NULL, OPT_MARGIN },
+    { "jobs",        required_argument, NULL, OPT_JOBS },
+    { "serve",       required_argument, NULL, OPT_SERVE },
+    { "jobs-file",   required_argument, NULL, OPT_JOBS_FILE },
+    { "retries",     required_argument, NULL, OPT_RETRIES },
+    { "job-timeout", required_argument, NULL, OPT_JOB_TIMEOUT },
+    { "worker",      required_argument, NULL, OPT_WORKER },
+    { "live",        required_argument, NULL, OPT_LIVE },
+    { "checkpoint",  required_argument, NULL, OPT_CHECKPOINT },
+    { "resume",      required_argument, NULL, OPT_RESUME },
+    { "hotspots",    optional_argument, NULL, OPT_HOTSPOTS },
+    { "fu-config",   required_argument, NULL, OPT_FU_CONFIG },
+    { "bypass",      required_argument, NULL, OPT_BYPASS },
+    { "dispatch-width", required_argument, NULL, OPT_DISPATCH_WIDTH },
+    { "schedule-width", required_argument, NULL, OPT_SCHEDULE_WIDTH },
+    { "clusters",    required_argument, NULL, OPT_CLUSTERS },
+    { "steer",       required_argument, NULL, OPT_STEER },
+    { "xcluster-delay", required_argument, NULL, OPT_XCLUSTER_DELAY },
+    { "activity",    no_argument,       NULL, OPT_ACTIVITY },
+    { "energy",      required_argument, NULL, OPT_ENERGY },
+    { "report",      required_argument, NULL, OPT_REPORT },
+    { "knee",        required_argument, NULL, OPT_KNEE },
+    { "synthetic",   required_argument, NULL, OPT_SYNTHETIC },
+    { "quiet",       no_argument,       NULL, OPT_QUIET },
+    { "preload",     no_argument,       NULL, OPT_PRELOAD },
+    { "pin",         no_argument,       NULL, OPT_PIN },
+    { "policy",      required_argument, NULL, OPT_POLICY },
+    { "warmup",      required_argument, NULL, OPT_WARMUP },
+    { "roi",         required_argument, NULL, OPT_ROI },
+    { "debug",       no_argument,       NULL, OPT_DEBUG },
+    { "flight-recorder", required_argument, NULL, OPT_FLIGHT_RECORDER },
+    { "flight-log",  required_argument, NULL, OPT_FLIGHT_LOG },
+    { "watchdog",    required_argument, NULL, OPT_WATCHDOG },
+    { "critical-path", no_argument,     NULL, OPT_CRITICAL_PATH },
+    { "occupancy",   no_argument,       NULL, OPT_OCCUPANCY },
+    { "occupancy-csv", required_argument, NULL, OPT_OCCUPANCY_CSV },
+    { "parse-threads", required_argument, NULL, OPT_PARSE_THREADS },
+    { "first-tag",   required_argument, NULL, OPT_FIRST_TAG },
+    { "help",        no_argument,       NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+};
+
+/**
+ * Prints the processor settings in effect. A resumed run takes them from the
+ * checkpoint, so they are read back from the engine instead of the command line.
+ */
+static void print_settings(bool resumed, uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2,
+                           uint64_t f, bool list_classes)
+{
+    if (resumed) {
+        r = g_r;
+        f = g_f;
+        uint64_t* k[3] = { &k0, &k1, &k2 };
+        bool default_classes = g_num_fu_classes == 3;
+        for (uint64_t i = 0; i < g_num_fu_classes; i++) {
+            if (i < 3) {
+                *k[i] = g_fu_classes[i].count;
+            }
+            default_classes = default_classes && g_fu_classes[i].latency == 1 && !g_fu_classes[i].pipelined;
+        }
+        list_classes = !default_classes;
+    }
+
+    printf("Processor Settings\n");
+    printf("R: %" PRIu64 "\n", r);
+    printf("k0: %" PRIu64 "\n", k0);
+    printf("k1: %" PRIu64 "\n", k1);
+    printf("k2: %" PRIu64 "\n", k2);
+    printf("F: %"  PRIu64 "\n", f);
+    printf("\n");
+
+    if (list_classes) {
+        printf("FU classes:\n");
+        for (uint64_t i = 0; i < g_num_fu_classes; i++) {
+            printf("%" PRIu64 ": count %" PRIu64 ", latency %" PRIu64 "%s\n", i, g_fu_classes[i].count,
+                   g_fu_classes[i].latency, g_fu_classes[i].pipelined ? ", pipelined" : "");
+        }
+        printf("\n");
+    }
+}
 
 int main(int argc, char* argv[]) {
     int opt;
@@ -53,8 +335,39 @@ int main(int argc, char* argv[]) {
     uint64_t k2 = DEFAULT_K2;
     uint64_t r = DEFAULT_R;
 
+    bool tune = false;
+    tune_options_t tune_opts;
+    memset(&tune_opts, 0, sizeof(tune_opts));
+    tune_opts.max_fu = DEFAULT_TUNE_MAX_FU;
+    tune_opts.max_r = DEFAULT_TUNE_MAX_R;
+    tune_opts.cost_fu = 1.0;
+    tune_opts.cost_r = 1.0;
+    tune_opts.sample = DEFAULT_TUNE_SAMPLE;
+    tune_opts.margin = DEFAULT_TUNE_MARGIN;
+
+    const char* serve_addr = NULL;
+    const char* jobs_file = NULL;
+    const char* worker_addr = NULL;
+    int retries = DEFAULT_DIST_RETRIES;
+    uint64_t job_timeout = DEFAULT_DIST_JOB_TIMEOUT;
+    const char* live_name = NULL;
+    const char* resume_path = NULL;
+    const char* fu_config_path = NULL;
+    bool print_activity = false;
+    const char* energy_path = NULL;
+    bool print_occupancy_table = false;
+    g_trace_threads = default_worker_count();
+    const char* occupancy_csv = NULL;
+    const char* report_path = NULL;
+    double knee = DEFAULT_REPORT_KNEE;
+    uint64_t warmup = 0;
+    bool warmup_cycles = false;
+    bool roi = false;
+    uint64_t roi_start = 0, roi_end = 0;
+    bool roi_cycles = false;
+
     /* Read arguments */ 
-    while(-1 != (opt = getopt(argc, argv, "r:i:j:k:l:f:h"))) {
+    while(-1 != (opt = getopt_long(argc, argv, "r:i:j:k:l:f:h", long_options, NULL))) {
         switch(opt) {
         case 'r':
             r = atoi(optarg);
@@ -78,6 +391,178 @@ int main(int argc, char* argv[]) {
                 fprintf(stderr, "Failed to open %s for reading\n", optarg);
                 print_help_and_exit();
             }
+            inPath = optarg;
+            break;
+        case OPT_TUNE:
+            tune = true;
+            break;
+        case OPT_COST:
+            if (sscanf(optarg, "%lf,%lf", &tune_opts.cost_fu, &tune_opts.cost_r) != 2) {
+                fprintf(stderr, "--cost expects A,B\n");
+                print_help_and_exit();
+            }
+            break;
+        case OPT_TUNE_MAX_FU:
+            tune_opts.max_fu = atoi(optarg);
+            break;
+        case OPT_TUNE_MAX_R:
+            tune_opts.max_r = atoi(optarg);
+            break;
+        case OPT_SAMPLE:
+            tune_opts.sample = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_MARGIN:
+            tune_opts.margin = atof(optarg);
+            break;
+        case OPT_JOBS:
+            tune_opts.workers = atoi(optarg);
+            break;
+        case OPT_SERVE:
+            serve_addr = optarg;
+            break;
+        case OPT_JOBS_FILE:
+            jobs_file = optarg;
+            break;
+        case OPT_RETRIES:
+            retries = atoi(optarg);
+            break;
+        case OPT_JOB_TIMEOUT:
+            job_timeout = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_WORKER:
+            worker_addr = optarg;
+            break;
+        case OPT_LIVE:
+            live_name = optarg;
+            break;
+        case OPT_CHECKPOINT:
+            g_checkpoint_path = optarg;
+            break;
+        case OPT_RESUME:
+            resume_path = optarg;
+            break;
+        case OPT_FU_CONFIG:
+            fu_config_path = optarg;
+            break;
+        case OPT_BYPASS:
+            g_bypass_paths = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_DISPATCH_WIDTH:
+            g_dispatch_width = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_SCHEDULE_WIDTH:
+            g_schedule_width = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_CLUSTERS:
+            g_num_clusters = atoi(optarg);
+            if (g_num_clusters < 1 || g_num_clusters > MAX_CLUSTERS) {
+                fprintf(stderr, "--clusters must be between 1 and %d\n", MAX_CLUSTERS);
+                print_help_and_exit();
+            }
+            break;
+        case OPT_STEER:
+            if (strcmp(optarg, "rr") == 0) {
+                g_steer_policy = STEER_ROUND_ROBIN;
+            } else if (strcmp(optarg, "dep") == 0) {
+                g_steer_policy = STEER_DEPENDENCE;
+            } else {
+                fprintf(stderr, "Unknown steering policy %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case OPT_XCLUSTER_DELAY:
+            g_xcluster_delay = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_ACTIVITY:
+            print_activity = true;
+            break;
+        case OPT_ENERGY:
+            energy_path = optarg;
+            break;
+        case OPT_REPORT:
+            report_path = optarg;
+            break;
+        case OPT_KNEE:
+            knee = atof(optarg);
+            break;
+        case OPT_SYNTHETIC:
+            synthetic = true;
+            synthetic_count = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_QUIET:
+            g_print_events = false;
+            break;
+        case OPT_PRELOAD:
+            preload = true;
+            break;
+        case OPT_FIRST_TAG:
+            g_first_tag = strtoull(optarg, NULL, 10);
+            if (g_first_tag == 0) {
+                fprintf(stderr, "--first-tag must be at least 1\n");
+                print_help_and_exit();
+            }
+            break;
+        case OPT_PARSE_THREADS:
+            g_trace_threads = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_PIN:
+            g_pin_workers = true;
+            break;
+        case OPT_POLICY: {
+            int policy = find_sched_policy(optarg);
+            if (policy < 0) {
+                fprintf(stderr, "Unknown scheduling policy %s\n", optarg);
+                print_help_and_exit();
+            }
+            g_sched_policy = policy;
+            break;
+        }
+        case OPT_WARMUP: {
+            char* end;
+            if (!parse_bound(optarg, &end, &warmup, &warmup_cycles) || *end != '\0') {
+                fprintf(stderr, "Bad --warmup %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        }
+        case OPT_ROI: {
+            char* end;
+            bool end_cycles;
+            roi_end = 0;
+            if (!parse_bound(optarg, &end, &roi_start, &roi_cycles) || *end++ != ':' ||
+                (*end != '\0' && (!parse_bound(end, &end, &roi_end, &end_cycles) || *end != '\0' ||
+                                  end_cycles != roi_cycles || roi_end <= roi_start))) {
+                fprintf(stderr, "Bad --roi %s\n", optarg);
+                print_help_and_exit();
+            }
+            roi = true;
+            break;
+        }
+        case OPT_DEBUG:
+            g_debug = true;
+            break;
+        case OPT_FLIGHT_RECORDER:
+            g_flight_cycles = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_FLIGHT_LOG:
+            g_flight_path = optarg;
+            break;
+        case OPT_WATCHDOG:
+            g_watchdog_cycles = strtoull(optarg, NULL, 10);
+            break;
+        case OPT_CRITICAL_PATH:
+            g_critical_path = true;
+            break;
+        case OPT_OCCUPANCY:
+            print_occupancy_table = true;
+            g_occupancy = true;
+            break;
+        case OPT_OCCUPANCY_CSV:
+            occupancy_csv = optarg;
+            g_occupancy = true;
+            break;
+        case OPT_HOTSPOTS:
+            g_hotspot_top = optarg ? strtoull(optarg, NULL, 10) : DEFAULT_HOTSPOT_TOP;
             break;
         case 'h':
             /* Fall through */
@@ -87,16 +572,121 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    printf("Processor Settings\n");
-    printf("R: %" PRIu64 "\n", r);
-    printf("k0: %" PRIu64 "\n", k0);
-    printf("k1: %" PRIu64 "\n", k1);
-    printf("k2: %" PRIu64 "\n", k2);
-    printf("F: %"  PRIu64 "\n", f);
-    printf("\n");
+    if (k0 == 0 || k1 == 0 || k2 == 0) {
+        // Opcodes of a class without units could never fire and the run would hang
+        fprintf(stderr, "-j, -k and -l must each be at least 1\n");
+        print_help_and_exit();
+    }
+
+    if (report_path != NULL) {
+        report_options_t report_opts;
+        report_opts.path = report_path;
+        report_opts.cost_fu = tune_opts.cost_fu;
+        report_opts.cost_r = tune_opts.cost_r;
+        report_opts.knee = knee;
+        return run_report(&report_opts);
+    }
+
+    if (serve_addr != NULL) {
+        if (jobs_file == NULL) {
+            fprintf(stderr, "--serve requires --jobs-file\n");
+            print_help_and_exit();
+        }
+        return run_coordinator(serve_addr, jobs_file, retries, job_timeout);
+    }
+
+    if (worker_addr != NULL) {
+        return run_worker(worker_addr, tune_opts.workers);
+    }
+
+    if (tune) {
+        if (inPath == NULL) {
+            fprintf(stderr, "--tune requires a trace file given with -i\n");
+            print_help_and_exit();
+        }
+        tune_opts.trace = inPath;
+        tune_opts.f = f;
+        return run_autotune(&tune_opts);
+    }
+
+    if (g_critical_path && (resume_path != NULL || g_debug)) {
+        fprintf(stderr, "--critical-path follows the run from its start and cannot be combined with --resume or --debug\n");
+        print_help_and_exit();
+    }
+#ifdef PROCSIM_OBSERVER_HEADER
+    if (g_debug) {
+        // Reverse steps replay cycles, and the observer is not in the snapshots
+        fprintf(stderr, "--debug would show the plugged-in observer rewound cycles twice; build without OBSERVER to debug\n");
+        print_help_and_exit();
+    }
+#endif
+
+    if (g_debug) {
+        if (inFile == stdin && !synthetic) {
+            fprintf(stderr, "--debug reads commands from stdin, give the trace with -i\n");
+            print_help_and_exit();
+        }
+        g_print_progress = false;
+    }
+
+    energy_table_t energy_table;
+    if (energy_path != NULL && !load_energy_table(energy_path, &energy_table)) {
+        return 1;
+    }
+
+    fu_class_t fu_classes[MAX_FU_CLASSES];
+    uint64_t num_fu_classes = 0;
+    int32_t opcode_class[MAX_OPCODE + 2];
+    if (fu_config_path != NULL) {
+        if (!load_fu_config(fu_config_path, fu_classes, &num_fu_classes, opcode_class)) {
+            return 1;
+        }
+    }
+
+    if (live_name != NULL) {
+        g_live = open_live_stats(live_name, true);
+        if (g_live == NULL) {
+            return 1;
+        }
+    }
+
+    // Reverse stepping rewinds the trace, so the debugger keeps all of it in memory
+    std::vector<proc_inst_t> debug_insts;
+    trace_source_t trace;
+    if (synthetic) {
+        trace_from_synthetic(&trace, synthetic_count);
+    } else if (preload) {
+        if (!trace_preload(&trace, inFile)) {
+            return 1;
+        }
+    } else if (g_debug) {
+        trace_decode_all(inFile, debug_insts);
+        trace_from_memory(&trace, debug_insts.data(), debug_insts.size());
+    } else {
+        trace_from_text(&trace, inFile);
+    }
+    g_trace = &trace;
+
+    if (warmup > 0) {
+        add_region("warmup", warmup_cycles, 0, warmup);
+        if (!roi) {
+            add_region("measured", warmup_cycles, warmup, 0);
+        }
+    }
+    if (roi) {
+        add_region("roi", roi_cycles, roi_start, roi_end);
+    }
 
     /* Setup the processor */
     setup_proc(r, k0, k1, k2, f);
+    if (fu_config_path != NULL) {
+        setup_fu_classes(fu_classes, num_fu_classes, opcode_class);
+    }
+    if (resume_path != NULL && !load_checkpoint(resume_path)) {
+        return 1;
+    }
+    print_settings(resume_path != NULL, r, k0, k1, k2, f, fu_config_path != NULL);
+    install_proc_signal_handlers();
 
     /* Setup statistics */
     proc_stats_t stats;
@@ -107,22 +697,75 @@ int main(int argc, char* argv[]) {
 
     /* Finalize stats */
     complete_proc(&stats);
+    trace_close(&trace);
 
     // Comment this out when submitting to gradescope
-    print_statistics(&stats);
+    print_statistics("Processor stats", &stats);
+
+    printf("%" PRIu64 "\n",stats.cycle_count);
+
+    for (uint64_t i = 0; i < g_num_regions; i++) {
+        const region_t* rg = &g_regions[i];
+        proc_stats_t region_stats;
+        char title[128], end[32] = "end";
+        if (rg->end != 0) {
+            snprintf(end, sizeof(end), "%" PRIu64, rg->end);
+        }
+        snprintf(title, sizeof(title), "\nRegion %s (%s %" PRIu64 " to %s) stats", rg->name,
+                 rg->in_cycles ? "cycles" : "instructions", rg->start, end);
+        if (get_region_stats(i, &region_stats)) {
+            print_statistics(title, &region_stats);
+        } else {
+            printf("%s: not reached\n", title);
+        }
+    }
 
-    printf("%lu\n",stats.cycle_count);
+    if (g_num_clusters > 1) {
+        print_cluster_stats(stdout);
+    }
+
+    if (print_activity || energy_path != NULL) {
+        activity_t activity;
+        get_activity(&activity);
+        print_energy_report(stdout, &activity, energy_path ? &energy_table : NULL,
+                            g_num_fu_classes, &stats);
+    }
+
+    if (g_hotspot_top > 0) {
+        print_hotspots(stdout, g_hotspot_top);
+    }
+
+    if (g_critical_path) {
+        print_critical_path(stdout, stats.cycle_count);
+    }
+
+    if (print_occupancy_table) {
+        print_occupancy(stdout);
+    }
+    if (occupancy_csv != NULL && !write_occupancy_csv(occupancy_csv)) {
+        return 1;
+    }
 
     return 0;
 }
 
-void print_statistics(proc_stats_t* p_stats) {
-    printf("Processor stats:\n");
-	printf("Total instructions: %lu\n", p_stats->retired_instruction);
+void print_statistics(const char* title, proc_stats_t* p_stats) {
+    printf("%s:\n", title);
+	printf("Total instructions: %" PRIu64 "\n", p_stats->retired_instruction);
         printf("Avg Dispatch queue size: %f\n", p_stats->avg_disp_size);
-        printf("Maximum Dispatch queue size: %lu\n", p_stats->max_disp_size);
+        printf("Maximum Dispatch queue size: %" PRIu64 "\n", p_stats->max_disp_size);
         printf("Avg inst fired per cycle: %f\n", p_stats->avg_inst_fired);
 	printf("Avg inst retired per cycle: %f\n", p_stats->avg_inst_retired);
-	printf("Total run time (cycles): %lu\n", p_stats->cycle_count);
+	printf("Total run time (cycles): %" PRIu64 "\n", p_stats->cycle_count);
+	if (g_bypass_paths > 0) {
+	    printf("Bypassed operand reads: %" PRIu64 "\n", p_stats->bypass_reads);
+	    printf("Register file operand reads: %" PRIu64 "\n", p_stats->regfile_reads);
+	}
+	if (g_dispatch_width > 0 || g_schedule_width > 0) {
+	    printf("Fetch stall cycles (fetch buffer full): %" PRIu64 "\n", p_stats->fetch_stall_cycles);
+	    printf("Dispatch width stall cycles: %" PRIu64 "\n", p_stats->dispatch_stall_cycles);
+	    printf("Schedule width stall cycles: %" PRIu64 "\n", p_stats->schedule_stall_cycles);
+	    printf("RS full stall cycles: %" PRIu64 "\n", p_stats->rs_full_cycles);
+	}
 }
 
@@ -0,0 +1,119 @@
+#include "procsim_energy.hpp"
+#include <cstring>
+#include <cinttypes>
+
+//
+// load_energy_table
+//
+//  Reads "<event> <pJ>" lines, e.g. "rs_cam_search 0.8", and "fu_op <class> <pJ>".
+//  Events: dq_write dq_read rs_write rs_wakeup_broadcast rs_cam_search
+//          result_bus_transfer scoreboard_read scoreboard_write static_per_cycle
+//  Events that are not listed cost nothing.
+//
+bool load_energy_table(const char* path, energy_table_t* p_table)
+{
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+
+    memset(p_table, 0, sizeof(energy_table_t));
+
+    const struct { const char* name; double* p_value; } events[] = {
+        { "dq_write", &p_table->dq_write },
+        { "dq_read", &p_table->dq_read },
+        { "rs_write", &p_table->rs_write },
+        { "rs_wakeup_broadcast", &p_table->rs_wakeup_broadcast },
+        { "rs_cam_search", &p_table->rs_cam_search },
+        { "result_bus_transfer", &p_table->result_bus_transfer },
+        { "scoreboard_read", &p_table->scoreboard_read },
+        { "scoreboard_write", &p_table->scoreboard_write },
+        { "static_per_cycle", &p_table->static_per_cycle },
+    };
+
+    char line[256];
+    unsigned line_no = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_no++;
+        char name[64];
+        double value;
+        int cls;
+        if (sscanf(line, "%63s", name) != 1 || name[0] == '#') {
+            continue;
+        }
+
+        bool ok = false;
+        if (strcmp(name, "fu_op") == 0) {
+            ok = sscanf(line, " fu_op %d %lf", &cls, &value) == 2 && cls >= 0 && cls < MAX_FU_CLASSES;
+            if (ok) {
+                p_table->fu_op[cls] = value;
+            }
+        } else if (sscanf(line, "%*s %lf", &value) == 1) {
+            for (size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+                if (strcmp(name, events[i].name) == 0) {
+                    *events[i].p_value = value;
+                    ok = true;
+                    break;
+                }
+            }
+        }
+
+        if (!ok) {
+            fprintf(stderr, "%s:%u: unknown event or bad value\n", path, line_no);
+            fclose(in);
+            return false;
+        }
+    }
+
+    fclose(in);
+    return true;
+}
+
+static double report_line(FILE* out, const char* name, uint64_t count, double pj)
+{
+    double energy = (double)count * pj;
+    fprintf(out, "%s\t%" PRIu64 "\t%f\t%f\n", name, count, pj, energy);
+    return energy;
+}
+
+/**
+ * Prints every activity counter with its energy, then total energy and energy-delay product.
+ * If p_table is NULL only the counts are printed.
+ */
+void print_energy_report(FILE* out, const activity_t* p_activity, const energy_table_t* p_table,
+                         uint64_t num_fu_classes, const proc_stats_t* p_stats)
+{
+    energy_table_t zero;
+    memset(&zero, 0, sizeof(zero));
+    const energy_table_t* t = p_table ? p_table : &zero;
+    const activity_t* a = p_activity;
+
+    fprintf(out, "Activity%s:\n", p_table ? " and energy" : "");
+    fprintf(out, "EVENT\tCOUNT\tPJ/EVENT\tENERGY (pJ)\n");
+
+    double total = 0.0;
+    total += report_line(out, "dq_write", a->dq_writes, t->dq_write);
+    total += report_line(out, "dq_read", a->dq_reads, t->dq_read);
+    total += report_line(out, "rs_write", a->rs_writes, t->rs_write);
+    total += report_line(out, "rs_wakeup_broadcast", a->rs_wakeup_broadcasts, t->rs_wakeup_broadcast);
+    total += report_line(out, "rs_cam_search", a->rs_cam_searches, t->rs_cam_search);
+    total += report_line(out, "result_bus_transfer", a->result_bus_transfers, t->result_bus_transfer);
+    total += report_line(out, "scoreboard_read", a->scoreboard_reads, t->scoreboard_read);
+    total += report_line(out, "scoreboard_write", a->scoreboard_writes, t->scoreboard_write);
+    for (uint64_t c = 0; c < num_fu_classes; c++) {
+        char name[32];
+        snprintf(name, sizeof(name), "fu_op %" PRIu64, c);
+        total += report_line(out, name, a->fu_ops[c], t->fu_op[c]);
+    }
+    total += report_line(out, "static_per_cycle", p_stats->cycle_count, t->static_per_cycle);
+
+    if (p_table == NULL) {
+        return;
+    }
+
+    fprintf(out, "Total energy (pJ): %f\n", total);
+    fprintf(out, "Energy per instruction (pJ): %f\n",
+            p_stats->retired_instruction ? total / p_stats->retired_instruction : 0.0);
+    fprintf(out, "EDP (pJ*cycles): %e\n", total * (double)p_stats->cycle_count);
+}
@@ -0,0 +1,26 @@
+#ifndef PROCSIM_ENERGY_HPP
+#define PROCSIM_ENERGY_HPP
+
+#include <cstdio>
+#include "procsim.hpp"
+
+// Energy per event in pJ, one entry per activity_t counter, plus static energy per cycle
+typedef struct _energy_table_t
+{
+    double dq_write;
+    double dq_read;
+    double rs_write;
+    double rs_wakeup_broadcast;
+    double rs_cam_search;
+    double result_bus_transfer;
+    double scoreboard_read;
+    double scoreboard_write;
+    double fu_op[MAX_FU_CLASSES];
+    double static_per_cycle;
+} energy_table_t;
+
+bool load_energy_table(const char* path, energy_table_t* p_table);
+void print_energy_report(FILE* out, const activity_t* p_activity, const energy_table_t* p_table,
+                         uint64_t num_fu_classes, const proc_stats_t* p_stats);
+
+#endif /* PROCSIM_ENERGY_HPP */
@@ -0,0 +1,224 @@
+#include "procsim_flight.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+
+//
+// Flight recorder: run_proc() keeps its recent pipeline events in a ring of 16-byte
+// records whether or not the event log is printed. When the run dies (a fatal or
+// terminating signal, exit() with a non-zero status inside run_proc, or the watchdog)
+// the ring is written to g_flight_path in the event log format, so procsim-log and
+// procsim-diff read it like any other log.
+//
+// The dump runs inside signal handlers, so it only uses write() and hand-rolled
+// number formatting.
+//
+
+uint64_t g_flight_cycles = DEFAULT_FLIGHT_CYCLES;
+const char* g_flight_path = DEFAULT_FLIGHT_PATH;
+
+flight_event_t* flight_ring = NULL;
+uint64_t flight_mask = 0;
+uint64_t flight_next = 0;
+
+// Set while run_proc runs; an exit() in that window is abnormal
+volatile sig_atomic_t flight_armed = 0;
+
+static const struct
+{
+    int sig;
+    const char* name;
+} fatal_signals[] = {
+    { SIGSEGV, "SIGSEGV" }, { SIGBUS, "SIGBUS" }, { SIGFPE, "SIGFPE" }, { SIGILL, "SIGILL" },
+    { SIGABRT, "SIGABRT" }, { SIGINT, "SIGINT" }, { SIGTERM, "SIGTERM" }, { SIGQUIT, "SIGQUIT" },
+};
+#define NUM_FATAL_SIGNALS (sizeof(fatal_signals) / sizeof(fatal_signals[0]))
+
+// Handlers the recorder replaced (e.g. the live stats cleanup), run after the dump
+static struct sigaction previous_actions[NUM_FATAL_SIGNALS];
+
+/**
+ * Empties the ring, allocating it on first use.
+ */
+void flight_reset(void)
+{
+    if (flight_ring == NULL) {
+        flight_ring = (flight_event_t*)malloc(MIN_FLIGHT_EVENTS * sizeof(flight_event_t));
+        flight_mask = MIN_FLIGHT_EVENTS - 1;
+    }
+    memset(flight_ring, 0, (flight_mask + 1) * sizeof(flight_event_t));
+    flight_next = 0;
+}
+
+void flight_grow(void)
+{
+    uint64_t size = flight_mask + 1;
+    flight_event_t* ring = (flight_event_t*)calloc(2 * size, sizeof(flight_event_t));
+    if (ring == NULL) {
+        // Keep overwriting the ring we have (one cycle never fills it) rather than fail the run
+        g_flight_cycles = 1;
+        return;
+    }
+    uint64_t first = flight_next > size ? flight_next - size : 0;
+    for (uint64_t seq = first; seq < flight_next; seq++) {
+        ring[seq & (2 * size - 1)] = flight_ring[seq & flight_mask];
+    }
+
+    // A signal between the two stores would dump the new ring with the old mask, so hold
+    // signals off until both are published. The trace parser threads start with signals
+    // blocked, so asynchronous ones are delivered to this thread.
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    flight_event_t* old = flight_ring;
+    flight_ring = ring;
+    flight_mask = 2 * size - 1;
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    free(old);
+}
+
+// Output buffer for flight_dump()
+typedef struct _dump_buf_t
+{
+    int fd;
+    size_t len;
+    char data[1 << 16];
+} dump_buf_t;
+
+static dump_buf_t dump_buf;
+
+static void dump_flush(dump_buf_t* b)
+{
+    size_t off = 0;
+    while (off < b->len) {
+        ssize_t n = write(b->fd, b->data + off, b->len - off);
+        if (n <= 0) {
+            break;
+        }
+        off += n;
+    }
+    b->len = 0;
+}
+
+static void dump_str(dump_buf_t* b, const char* s)
+{
+    for (; *s != '\0'; s++) {
+        if (b->len == sizeof(b->data)) {
+            dump_flush(b);
+        }
+        b->data[b->len++] = *s;
+    }
+}
+
+static void dump_u64(dump_buf_t* b, uint64_t v)
+{
+    char digits[21];
+    int i = sizeof(digits) - 1;
+    digits[i] = '\0';
+    do {
+        digits[--i] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    dump_str(b, digits + i);
+}
+
+/**
+ * Writes the recorded events, oldest first, to g_flight_path. Safe to call from a
+ * signal handler; only the first call of a run writes anything.
+ */
+void flight_dump(const char* reason)
+{
+    if (flight_ring == NULL || g_flight_cycles == 0 || !flight_armed) {
+        return;
+    }
+    flight_armed = 0;
+
+    dump_buf_t* b = &dump_buf;
+    b->len = 0;
+    b->fd = open(g_flight_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (b->fd < 0) {
+        b->fd = STDERR_FILENO;
+        dump_str(b, "Failed to open the flight recorder log\n");
+        dump_flush(b);
+        return;
+    }
+
+    uint64_t size = flight_mask + 1;
+    uint64_t first = flight_next > size ? flight_next - size : 0;
+    uint64_t events = 0;
+    dump_str(b, "# procsim flight recorder: ");
+    dump_str(b, reason);
+    dump_str(b, "\n");
+    for (uint64_t seq = first; seq < flight_next; seq++) {
+        const flight_event_t* e = &flight_ring[seq & flight_mask];
+        if (e->cycle_event == 0) {
+            continue;
+        }
+        dump_u64(b, e->cycle_event >> 3);
+        dump_str(b, "\t");
+        dump_str(b, g_event_names[e->cycle_event & 7]);
+        dump_str(b, "\t");
+        dump_u64(b, e->tag);
+        dump_str(b, "\n");
+        events++;
+    }
+    dump_flush(b);
+    close(b->fd);
+
+    b->fd = STDERR_FILENO;
+    dump_str(b, "Flight recorder (");
+    dump_str(b, reason);
+    dump_str(b, "): last ");
+    dump_u64(b, events);
+    dump_str(b, " events written to ");
+    dump_str(b, g_flight_path);
+    dump_str(b, "\n");
+    dump_flush(b);
+}
+
+static void handle_fatal_signal(int sig)
+{
+    const char* name = "signal";
+    const struct sigaction* previous = NULL;
+    for (size_t i = 0; i < NUM_FATAL_SIGNALS; i++) {
+        if (fatal_signals[i].sig == sig) {
+            name = fatal_signals[i].name;
+            previous = &previous_actions[i];
+        }
+    }
+    flight_dump(name);
+
+    // Hand the signal on to the handler we replaced, or die of it
+    if (previous != NULL && previous->sa_handler != SIG_DFL && previous->sa_handler != SIG_IGN) {
+        sigaction(sig, previous, NULL);
+    } else {
+        signal(sig, SIG_DFL);
+    }
+    raise(sig);
+}
+
+static void flight_on_exit(int status, void*)
+{
+    if (status != 0) {
+        flight_dump("exit during the run");
+    }
+}
+
+/**
+ * Dumps the flight recorder when the process dies of a signal or exits with an error
+ * while run_proc is running.
+ */
+void install_flight_handlers(void)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = handle_fatal_signal;
+    for (size_t i = 0; i < NUM_FATAL_SIGNALS; i++) {
+        sigaction(fatal_signals[i].sig, &sa, &previous_actions[i]);
+    }
+    on_exit(flight_on_exit, NULL);
+}
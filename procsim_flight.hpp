@@ -0,0 +1,51 @@
+#ifndef PROCSIM_FLIGHT_HPP
+#define PROCSIM_FLIGHT_HPP
+
+#include <cstdint>
+#include <csignal>
+#include "procsim.hpp"
+
+#define DEFAULT_FLIGHT_CYCLES 1000
+#define DEFAULT_FLIGHT_PATH "procsim.flight.log"
+#define MIN_FLIGHT_EVENTS 4096
+
+// One pipeline event as the flight recorder keeps it
+typedef struct _flight_event_t
+{
+    uint64_t cycle_event;        // cycle << 3 | pipeline_event_t, 0 marks an empty slot
+    uint64_t tag;
+} flight_event_t;
+
+// Cycles of events the recorder keeps (0 = off) and where it dumps them
+extern uint64_t g_flight_cycles;
+extern const char* g_flight_path;
+
+// Ring of recent events, indexed by sequence number & flight_mask
+extern flight_event_t* flight_ring;
+extern uint64_t flight_mask;
+extern uint64_t flight_next;
+extern volatile sig_atomic_t flight_armed;
+
+void flight_reset(void);
+void flight_grow(void);
+void flight_dump(const char* reason);
+void install_flight_handlers(void);
+
+/**
+ * Records one event. The ring doubles instead of overwriting an event from the last
+ * g_flight_cycles cycles, so it always covers that window.
+ */
+static inline void flight_record(uint64_t cycle, int event, uint64_t tag)
+{
+    flight_event_t* e = &flight_ring[flight_next & flight_mask];
+    uint64_t old = e->cycle_event >> 3;
+    if (e->cycle_event != 0 && old <= cycle && cycle - old < g_flight_cycles) {
+        flight_grow();
+        e = &flight_ring[flight_next & flight_mask];
+    }
+    e->cycle_event = cycle << 3 | event;
+    e->tag = tag;
+    flight_next++;
+}
+
+#endif /* PROCSIM_FLIGHT_HPP */
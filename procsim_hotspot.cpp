@@ -0,0 +1,139 @@
+#include "procsim_hotspot.hpp"
+#include <cstdlib>
+#include <cinttypes>
+#include <vector>
+#include <algorithm>
+
+uint64_t g_hotspot_top = 0;
+
+// Open-addressing table with linear probing; capacity is a power of two
+// and the table doubles once it is half full.
+static hotspot_entry_t* table = NULL;
+static uint64_t table_mask = 0;
+static uint64_t table_used = 0;
+
+static inline uint64_t hotspot_slot(uint32_t pc)
+{
+    // Fibonacci hashing spreads the word-aligned addresses over the table
+    return ((uint64_t)pc * 0x9E3779B97F4A7C15ull) >> 32;
+}
+
+static void hotspot_grow(void)
+{
+    uint64_t old_capacity = table ? table_mask + 1 : 0;
+    uint64_t capacity = old_capacity ? old_capacity * 2 : 4096;
+    hotspot_entry_t* old = table;
+
+    table = (hotspot_entry_t*)calloc(capacity, sizeof(hotspot_entry_t));
+    if (table == NULL) {
+        fprintf(stderr, "Out of memory growing the hotspot table\n");
+        exit(1);
+    }
+    table_mask = capacity - 1;
+
+    for (uint64_t i = 0; i < old_capacity; i++) {
+        if (old[i].count != 0) {
+            uint64_t slot = hotspot_slot(old[i].pc) & table_mask;
+            while (table[slot].count != 0) {
+                slot = (slot + 1) & table_mask;
+            }
+            table[slot] = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * Slot of the instruction at pc, claimed (with a zero count) if it has none yet.
+ */
+static hotspot_entry_t* hotspot_find(uint32_t pc)
+{
+    if (table == NULL || table_used * 2 >= table_mask + 1) {
+        hotspot_grow();
+    }
+
+    uint64_t slot = hotspot_slot(pc) & table_mask;
+    while (table[slot].count != 0 && table[slot].pc != pc) {
+        slot = (slot + 1) & table_mask;
+    }
+
+    hotspot_entry_t* e = &table[slot];
+    if (e->count == 0) {
+        e->pc = pc;
+        table_used++;
+    }
+    return e;
+}
+
+/**
+ * Adds one retired instance of the instruction at pc and its stall cycles.
+ */
+void hotspot_record(uint32_t pc, uint64_t dq_wait, uint64_t rs_wait, uint64_t bus_wait)
+{
+    hotspot_entry_t* e = hotspot_find(pc);
+    e->count++;
+    e->dq_wait += dq_wait;
+    e->rs_wait += rs_wait;
+    e->bus_wait += bus_wait;
+}
+
+/**
+ * Prints the `top` static instructions with the most total stall cycles.
+ */
+void print_hotspots(FILE* out, uint64_t top)
+{
+    std::vector<hotspot_entry_t> entries;
+    for (uint64_t i = 0; table != NULL && i <= table_mask; i++) {
+        if (table[i].count != 0) {
+            entries.push_back(table[i]);
+        }
+    }
+
+    size_t n = std::min<size_t>(top, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + n, entries.end(),
+        [](const hotspot_entry_t& a, const hotspot_entry_t& b) {
+            uint64_t ta = a.dq_wait + a.rs_wait + a.bus_wait;
+            uint64_t tb = b.dq_wait + b.rs_wait + b.bus_wait;
+            if (ta != tb) {
+                return ta > tb;
+            }
+            return a.pc < b.pc;
+        });
+
+    fprintf(out, "Stall hotspots (top %zu of %zu static instructions):\n", n, entries.size());
+    fprintf(out, "PC\tCOUNT\tDQ\tRS\tBUS\tTOTAL\n");
+    for (size_t i = 0; i < n; i++) {
+        const hotspot_entry_t* e = &entries[i];
+        fprintf(out, "%x\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n", e->pc, e->count, e->dq_wait, e->rs_wait,
+                e->bus_wait, e->dq_wait + e->rs_wait + e->bus_wait);
+    }
+}
+
+/**
+ * Copies the recorded instructions out, for checkpoints.
+ */
+void hotspot_save(std::vector<hotspot_entry_t>* entries)
+{
+    entries->clear();
+    for (uint64_t i = 0; table != NULL && i <= table_mask; i++) {
+        if (table[i].count != 0) {
+            entries->push_back(table[i]);
+        }
+    }
+}
+
+/**
+ * Replaces the table with entries hotspot_save() copied out.
+ */
+void hotspot_restore(const std::vector<hotspot_entry_t>& entries)
+{
+    free(table);
+    table = NULL;
+    table_mask = 0;
+    table_used = 0;
+    for (const hotspot_entry_t& saved : entries) {
+        if (saved.count != 0) {
+            *hotspot_find(saved.pc) = saved;
+        }
+    }
+}
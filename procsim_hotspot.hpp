@@ -0,0 +1,28 @@
+#ifndef PROCSIM_HOTSPOT_HPP
+#define PROCSIM_HOTSPOT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#define DEFAULT_HOTSPOT_TOP 20
+
+// Stall cycles accumulated per static instruction (keyed by instruction_address)
+typedef struct _hotspot_entry_t
+{
+    uint32_t pc;
+    uint64_t count;      // Retired dynamic instances, 0 marks an empty slot
+    uint64_t dq_wait;    // Cycles waiting in the dispatch queue beyond the minimum
+    uint64_t rs_wait;    // Cycles waiting in the reservation station before firing
+    uint64_t bus_wait;   // Cycles waiting for a result bus after execution
+} hotspot_entry_t;
+
+// Number of hotspots printed at exit (0 = profiling off)
+extern uint64_t g_hotspot_top;
+
+void hotspot_record(uint32_t pc, uint64_t dq_wait, uint64_t rs_wait, uint64_t bus_wait);
+void print_hotspots(FILE* out, uint64_t top);
+void hotspot_save(std::vector<hotspot_entry_t>* entries);
+void hotspot_restore(const std::vector<hotspot_entry_t>& entries);
+
+#endif /* PROCSIM_HOTSPOT_HPP */
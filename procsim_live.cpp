@@ -0,0 +1,130 @@
+#include "procsim_live.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Segment the simulator created, removed when it exits
+static char created_name[256];
+
+static void unlink_live_stats(void)
+{
+    shm_unlink(created_name);
+}
+
+// Signals that end the process without running atexit handlers. The flight recorder,
+// installed later, hands these on to this handler after its dump.
+static const int exit_signals[] = {
+    SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGINT, SIGTERM, SIGQUIT, SIGHUP
+};
+
+static void handle_exit_signal(int sig)
+{
+    shm_unlink(created_name);
+
+    // Die of the same signal
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/**
+ * Maps the named shared-memory segment. The simulator creates and resets it, and
+ * removes the name when it exits or is killed by a catchable signal (readers that
+ * mapped it keep their mapping); readers map it read-only and fail if it does not
+ * exist yet.
+ */
+live_stats_t* open_live_stats(const char* name, bool create)
+{
+    int fd = shm_open(name, create ? (O_CREAT | O_RDWR) : O_RDONLY, 0644);
+    if (fd < 0) {
+        perror(name);
+        return NULL;
+    }
+
+    if (create && ftruncate(fd, sizeof(live_stats_t)) != 0) {
+        perror("ftruncate");
+        close(fd);
+        return NULL;
+    }
+
+    int prot = create ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* p = mmap(NULL, sizeof(live_stats_t), prot, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    live_stats_t* p_live = (live_stats_t*)p;
+    if (create) {
+        memset(p, 0, sizeof(live_stats_t));
+        p_live->magic = LIVE_STATS_MAGIC;
+        p_live->pid.store(getpid(), std::memory_order_relaxed);
+        if (created_name[0] == '\0') {
+            atexit(unlink_live_stats);
+
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sigemptyset(&sa.sa_mask);
+            sa.sa_handler = handle_exit_signal;
+            for (size_t i = 0; i < sizeof(exit_signals) / sizeof(exit_signals[0]); i++) {
+                sigaction(exit_signals[i], &sa, NULL);
+            }
+        }
+        snprintf(created_name, sizeof(created_name), "%s", name);
+    } else if (p_live->magic != LIVE_STATS_MAGIC) {
+        fprintf(stderr, "%s is not a procsim live stats segment\n", name);
+        munmap(p, sizeof(live_stats_t));
+        return NULL;
+    }
+    return p_live;
+}
+
+/**
+ * Whether the simulator that created the segment is still running.
+ */
+bool live_writer_alive(const live_stats_t* p_live)
+{
+    pid_t pid = (pid_t)p_live->pid.load(std::memory_order_relaxed);
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+/**
+ * Takes a consistent copy of the published counters without blocking the writer.
+ * Returns false if the writer died in the middle of an update, leaving seq odd.
+ */
+bool read_live_stats(const live_stats_t* p_live, live_snapshot_t* p_snap)
+{
+    for (uint64_t spins = 1;; spins++) {
+        uint64_t seq = p_live->seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            if (spins % 1024 == 0 && !live_writer_alive(p_live)) {
+                return false;
+            }
+            continue;
+        }
+
+        p_snap->current_cycle = p_live->current_cycle.load(std::memory_order_relaxed);
+        p_snap->total_retired = p_live->total_retired.load(std::memory_order_relaxed);
+        p_snap->total_fired = p_live->total_fired.load(std::memory_order_relaxed);
+        p_snap->dq_size = p_live->dq_size.load(std::memory_order_relaxed);
+        p_snap->rs_size = p_live->rs_size.load(std::memory_order_relaxed);
+        p_snap->rs_capacity = p_live->rs_capacity.load(std::memory_order_relaxed);
+        p_snap->num_fu_classes = p_live->num_fu_classes.load(std::memory_order_relaxed);
+        for (int i = 0; i < MAX_FU_CLASSES; i++) {
+            p_snap->fu_busy[i] = p_live->fu_busy[i].load(std::memory_order_relaxed);
+            p_snap->fu_count[i] = p_live->fu_count[i].load(std::memory_order_relaxed);
+        }
+        p_snap->finished = p_live->finished.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (p_live->seq.load(std::memory_order_relaxed) == seq) {
+            return true;
+        }
+    }
+}
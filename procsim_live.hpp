@@ -0,0 +1,67 @@
+#ifndef PROCSIM_LIVE_HPP
+#define PROCSIM_LIVE_HPP
+
+#include <cstdint>
+#include <atomic>
+#include "procsim.hpp"
+
+#define LIVE_STATS_MAGIC 0x50534c32u  // "PSL2"
+
+// Counters published by run_proc into shared memory for procsim-top.
+// Guarded by a seqlock: seq is odd while the simulator is writing, and a reader
+// retries until it sees the same even value before and after copying the fields.
+// pid lets readers notice a simulator that died without setting finished.
+typedef struct _live_stats_t
+{
+    uint32_t magic;
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> pid;
+
+    std::atomic<uint64_t> current_cycle;
+    std::atomic<uint64_t> total_retired;
+    std::atomic<uint64_t> total_fired;
+    std::atomic<uint64_t> dq_size;
+    std::atomic<uint64_t> rs_size;
+    std::atomic<uint64_t> rs_capacity;
+    std::atomic<uint64_t> num_fu_classes;
+    std::atomic<uint64_t> fu_busy[MAX_FU_CLASSES];
+    std::atomic<uint64_t> fu_count[MAX_FU_CLASSES];
+    std::atomic<uint64_t> finished;
+} live_stats_t;
+
+// Plain copy of live_stats_t taken by a reader
+typedef struct _live_snapshot_t
+{
+    uint64_t current_cycle;
+    uint64_t total_retired;
+    uint64_t total_fired;
+    uint64_t dq_size;
+    uint64_t rs_size;
+    uint64_t rs_capacity;
+    uint64_t num_fu_classes;
+    uint64_t fu_busy[MAX_FU_CLASSES];
+    uint64_t fu_count[MAX_FU_CLASSES];
+    uint64_t finished;
+} live_snapshot_t;
+
+// Set by the driver to make run_proc publish every cycle (NULL = off)
+extern live_stats_t* g_live;
+
+live_stats_t* open_live_stats(const char* name, bool create);
+bool read_live_stats(const live_stats_t* p_live, live_snapshot_t* p_snap);
+bool live_writer_alive(const live_stats_t* p_live);
+
+static inline void live_write_begin(live_stats_t* p_live)
+{
+    uint64_t seq = p_live->seq.load(std::memory_order_relaxed);
+    p_live->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+static inline void live_write_end(live_stats_t* p_live)
+{
+    uint64_t seq = p_live->seq.load(std::memory_order_relaxed);
+    p_live->seq.store(seq + 1, std::memory_order_release);
+}
+
+#endif /* PROCSIM_LIVE_HPP */
@@ -0,0 +1,348 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//
+// procsim-log: rebuilds the per-instruction timing table and the processor stats
+// from a procsim event log (CYCLE OPERATION INSTRUCTION lines). The log is mapped,
+// split across threads at line boundaries and parsed in parallel. Other lines, such
+// as the settings and stats procsim prints around the events, are ignored.
+//
+// Logs from the reference simulator (the output*/ archives) start with a
+// "CYCLE\tOPERATION\tINSTRUCTION" header and use different event semantics: DISPATCHED
+// marks leaving the dispatch queue, and the table's DISP and SCHED columns are the
+// cycles after FETCHED and DISPATCHED. Such logs are detected by the header, or forced
+// with -a, and then reproduce the archive's .output from the INST line on.
+//
+
+enum event_t
+{
+    EV_FETCHED,
+    EV_DISPATCHED,
+    EV_SCHEDULED,
+    EV_EXECUTED,
+    EV_STATE_UPDATE,
+    NUM_EVENTS
+};
+
+// Cycle of each event of one instruction, 0 if the log has none
+typedef struct _inst_row_t
+{
+    uint64_t cycle[NUM_EVENTS];
+} inst_row_t;
+
+typedef struct _chunk_t
+{
+    const char* begin;
+    const char* end;
+    uint64_t min_tag;    // UINT64_MAX if the chunk has no events
+    uint64_t max_tag;
+} chunk_t;
+
+#define ARCHIVE_HEADER "CYCLE\tOPERATION\tINSTRUCTION\n"
+
+static bool archive_format = false;
+
+void print_help_and_exit(void) {
+    printf("procsim-log [OPTIONS] FILE.log\n");
+    printf("  -t N\t\tParser threads (default: online cores)\n");
+    printf("  -s\t\tPrint only the stats, not the INST table\n");
+    printf("  -a\t\tRead the log with reference simulator semantics (default: detect by header)\n");
+    printf("  -h\t\tThis helpful output\n");
+    exit(0);
+}
+
+/**
+ * Parses one "CYCLE\tOPERATION\tTAG" line starting at p. Returns the start of the next
+ * line; *p_event is NUM_EVENTS when the line is not an event.
+ */
+static inline const char* parse_line(const char* p, const char* end, uint64_t* p_cycle,
+                                     int* p_event, uint64_t* p_tag)
+{
+    *p_event = NUM_EVENTS;
+
+    uint64_t cycle = 0;
+    const char* start = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        cycle = cycle * 10 + (*p++ - '0');
+    }
+    if (p == start || p >= end || *p != '\t') {
+        goto skip;
+    }
+    p++;
+
+    // The first letters tell the operations apart: FETCHED, DISPATCHED, SCHEDULED,
+    // EXECUTED, STATE UPDATE
+    int event;
+    if (end - p < 2) {
+        goto skip;
+    }
+    switch (p[0]) {
+    case 'F': event = EV_FETCHED; break;
+    case 'D': event = EV_DISPATCHED; break;
+    case 'E': event = EV_EXECUTED; break;
+    case 'S': event = p[1] == 'C' ? EV_SCHEDULED : p[1] == 'T' ? EV_STATE_UPDATE : NUM_EVENTS; break;
+    default: event = NUM_EVENTS; break;
+    }
+    if (event == NUM_EVENTS) {
+        goto skip;
+    }
+    while (p < end && *p != '\t' && *p != '\n') {
+        p++;
+    }
+    if (p >= end || *p != '\t') {
+        goto skip;
+    }
+    p++;
+
+    {
+        uint64_t tag = 0;
+        start = p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            tag = tag * 10 + (*p++ - '0');
+        }
+        if (p == start || tag == 0 || (p < end && *p != '\n')) {
+            goto skip;
+        }
+        *p_cycle = cycle;
+        *p_event = event;
+        *p_tag = tag;
+    }
+
+skip:
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+static void find_tag_range(chunk_t* c)
+{
+    uint64_t cycle, tag;
+    int event;
+    c->min_tag = UINT64_MAX;
+    c->max_tag = 0;
+    for (const char* p = c->begin; p < c->end;) {
+        p = parse_line(p, c->end, &cycle, &event, &tag);
+        if (event != NUM_EVENTS) {
+            c->min_tag = std::min(c->min_tag, tag);
+            c->max_tag = std::max(c->max_tag, tag);
+        }
+    }
+}
+
+/**
+ * Row i holds tag min_tag + i, so runs numbered from --first-tag need no more rows than
+ * instructions. Each event of an instruction appears once, so threads write disjoint fields.
+ */
+static void fill_rows(const chunk_t* c, uint64_t min_tag, inst_row_t* rows)
+{
+    uint64_t cycle, tag;
+    int event;
+    for (const char* p = c->begin; p < c->end;) {
+        p = parse_line(p, c->end, &cycle, &event, &tag);
+        if (event != NUM_EVENTS) {
+            rows[tag - min_tag].cycle[event] = cycle;
+        }
+    }
+}
+
+/**
+ * Formats rows [first, last) of the INST table.
+ */
+static void format_rows(const inst_row_t* rows, uint64_t min_tag, uint64_t first, uint64_t last,
+                        std::string* out)
+{
+    char line[128];
+    out->reserve((last - first) * 32);
+    for (uint64_t i = first; i < last; i++) {
+        const uint64_t* c = rows[i].cycle;
+        if (c[EV_FETCHED] == 0) {
+            continue;
+        }
+        uint64_t disp = c[EV_DISPATCHED], sched = c[EV_SCHEDULED];
+        if (archive_format) {
+            disp = c[EV_FETCHED] + 1;
+            sched = c[EV_DISPATCHED] ? c[EV_DISPATCHED] + 1 : 0;
+        }
+        int n = snprintf(line, sizeof(line), "%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64
+                         "\t%" PRIu64 "\t%" PRIu64 "\n", i + min_tag, c[EV_FETCHED], disp,
+                         sched, c[EV_EXECUTED], c[EV_STATE_UPDATE]);
+        out->append(line, n);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool stats_only = false;
+
+    while(-1 != (opt = getopt(argc, argv, "t:sah"))) {
+        switch(opt) {
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 's':
+            stats_only = true;
+            break;
+        case 'a':
+            archive_format = true;
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+    if (optind != argc - 1) {
+        print_help_and_exit();
+    }
+    if (threads <= 0) {
+        threads = 1;
+    }
+
+    const char* path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return 1;
+    }
+    size_t size = st.st_size;
+    const char* data = (const char*)"";
+    if (size > 0) {
+        data = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        madvise((void*)data, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    if (size >= strlen(ARCHIVE_HEADER) && memcmp(data, ARCHIVE_HEADER, strlen(ARCHIVE_HEADER)) == 0) {
+        archive_format = true;
+    }
+
+    // Split at line boundaries
+    std::vector<chunk_t> chunks(threads);
+    const char* p = data;
+    for (long i = 0; i < threads; i++) {
+        const char* end = data + size * (i + 1) / threads;
+        if (i == threads - 1) {
+            end = data + size;
+        } else if (end > p) {
+            const char* nl = (const char*)memchr(end - 1, '\n', data + size - (end - 1));
+            end = nl ? nl + 1 : data + size;
+        } else {
+            end = p;
+        }
+        chunks[i].begin = p;
+        chunks[i].end = end;
+        p = end;
+    }
+
+    std::vector<std::thread> workers;
+    for (long i = 0; i < threads; i++) {
+        workers.push_back(std::thread(find_tag_range, &chunks[i]));
+    }
+    uint64_t min_tag = UINT64_MAX, max_tag = 0;
+    for (long i = 0; i < threads; i++) {
+        workers[i].join();
+        min_tag = std::min(min_tag, chunks[i].min_tag);
+        max_tag = std::max(max_tag, chunks[i].max_tag);
+    }
+    workers.clear();
+    uint64_t num_insts = max_tag >= min_tag ? max_tag - min_tag + 1 : 0;
+
+    std::vector<inst_row_t> rows(num_insts);
+    memset(rows.data(), 0, num_insts * sizeof(inst_row_t));
+    for (long i = 0; i < threads; i++) {
+        workers.push_back(std::thread(fill_rows, &chunks[i], min_tag, rows.data()));
+    }
+    for (long i = 0; i < threads; i++) {
+        workers[i].join();
+    }
+    workers.clear();
+
+    if (!stats_only) {
+        std::vector<std::string> text(threads);
+        for (long i = 0; i < threads; i++) {
+            workers.push_back(std::thread(format_rows, rows.data(), min_tag, num_insts * i / threads,
+                                          num_insts * (i + 1) / threads, &text[i]));
+        }
+        printf("INST\tFETCH\tDISP\tSCHED\tEXEC\tSTATE\n");
+        for (long i = 0; i < threads; i++) {
+            workers[i].join();
+            fwrite(text[i].data(), 1, text[i].size(), stdout);
+        }
+        printf("\n");
+    }
+
+    // Aggregate the same way the simulator does: the DQ is sampled at the start of every
+    // cycle, so an instruction counts from the cycle after DISPATCHED up to SCHEDULED. In
+    // archive logs it counts from the cycle after FETCHED up to DISPATCHED.
+    uint64_t cycles = 0, retired = 0, fired = 0;
+    for (uint64_t i = 0; i < num_insts; i++) {
+        for (int e = 0; e < NUM_EVENTS; e++) {
+            cycles = std::max(cycles, rows[i].cycle[e]);
+        }
+        retired += rows[i].cycle[EV_STATE_UPDATE] != 0;
+        fired += rows[i].cycle[EV_EXECUTED] != 0;
+    }
+
+    std::vector<int64_t> dq_delta(cycles + 2, 0);
+    for (uint64_t i = 0; i < num_insts; i++) {
+        // The instruction is in the DQ for cycles [enter, leave)
+        uint64_t enter, leave;
+        if (archive_format) {
+            if (rows[i].cycle[EV_FETCHED] == 0) {
+                continue;
+            }
+            enter = rows[i].cycle[EV_FETCHED] + 1;
+            leave = rows[i].cycle[EV_DISPATCHED] ? rows[i].cycle[EV_DISPATCHED] + 1 : cycles + 1;
+        } else {
+            if (rows[i].cycle[EV_DISPATCHED] == 0) {
+                continue;
+            }
+            enter = rows[i].cycle[EV_DISPATCHED] + 1;
+            leave = (rows[i].cycle[EV_SCHEDULED] ? rows[i].cycle[EV_SCHEDULED] : cycles) + 1;
+        }
+        if (enter < leave) {
+            dq_delta[enter]++;
+            dq_delta[leave]--;
+        }
+    }
+    uint64_t dq_total = 0, dq_max = 0;
+    int64_t dq = 0;
+    for (uint64_t c = 1; c <= cycles; c++) {
+        dq += dq_delta[c];
+        dq_total += dq;
+        dq_max = std::max(dq_max, (uint64_t)dq);
+    }
+
+    // The reference simulator stores the averages as float
+    double n = cycles ? (double)cycles : 1.0;
+    double avg_dq = (double)dq_total / n, avg_fired = (double)fired / n, avg_retired = (double)retired / n;
+    if (archive_format) {
+        avg_dq = (float)avg_dq;
+        avg_fired = (float)avg_fired;
+        avg_retired = (float)avg_retired;
+    }
+    printf("Processor stats:\n");
+    printf("Total instructions: %" PRIu64 "\n", retired);
+    printf("Avg Dispatch queue size: %f\n", avg_dq);
+    printf("Maximum Dispatch queue size: %" PRIu64 "\n", dq_max);
+    printf("Avg inst fired per cycle: %f\n", avg_fired);
+    printf("Avg inst retired per cycle: %f\n", avg_retired);
+    printf("Total run time (cycles): %" PRIu64 "\n", cycles);
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef PROCSIM_OBSERVER_HPP
+#define PROCSIM_OBSERVER_HPP
+
+#include <cstdint>
+#include "procsim.hpp"
+
+//
+// Compile-time pipeline observers. run_proc() is instantiated for one observer type,
+// chosen when procsim.cpp is built, and calls its hooks directly, so there is no
+// virtual dispatch and the default null_observer_t compiles away entirely.
+//
+// To plug in an analysis, derive from pipeline_observer_t, override the hooks you
+// need (as non-virtual members with the same signatures) and build with
+//
+//   make OBSERVER=my_observer_t OBSERVER_HEADER=my_observer.hpp
+//
+// The engine's instance is g_observer; declare it extern in your header to read the
+// results after run_proc() returns. Its state is not saved in checkpoints or debugger
+// snapshots: after --resume it sees only the resumed cycles, and such builds refuse
+// --debug, whose reverse steps replay cycles.
+//
+
+template <class Derived>
+struct pipeline_observer_t
+{
+    void on_fetch(const proc_inst_t& inst, uint64_t cycle) {}
+    void on_dispatch(const proc_inst_t& inst, uint64_t cycle) {}
+    void on_schedule(const proc_inst_t& inst, uint64_t cycle) {}
+    void on_fire(const proc_inst_t& inst, uint64_t cycle) {}
+    void on_execute_complete(const proc_inst_t& inst, uint64_t cycle) {}
+    void on_state_update(const proc_inst_t& inst, uint64_t cycle) {}
+};
+
+struct null_observer_t : pipeline_observer_t<null_observer_t>
+{
+};
+
+#ifdef PROCSIM_OBSERVER_HEADER
+#include PROCSIM_OBSERVER_HEADER
+#endif
+
+#ifndef PROCSIM_OBSERVER
+#define PROCSIM_OBSERVER null_observer_t
+#endif
+
+#endif /* PROCSIM_OBSERVER_HPP */
@@ -0,0 +1,142 @@
+#include "procsim_occupancy.hpp"
+#include <cinttypes>
+#include <cstring>
+
+//
+// Occupancy histograms (--occupancy, --occupancy-csv): the fetch buffer, DQ and RS are
+// sampled at the start of every cycle (the DQ sample is the one behind "Avg Dispatch
+// queue size"), the FU pools after the fire stage, summed over clusters. Pipelined
+// units count as busy in the cycle they accept an instruction.
+//
+
+bool g_occupancy = false;
+
+std::vector<uint64_t> occupancy_hist[NUM_OCC_HISTS];
+
+void occupancy_reset(void)
+{
+    for (int i = 0; i < NUM_OCC_HISTS; i++) {
+        occupancy_hist[i].clear();
+    }
+}
+
+static int num_structures(void)
+{
+    return OCC_FU + (int)g_num_fu_classes;
+}
+
+static void structure_name(int s, char* buf, size_t len)
+{
+    static const char* const names[OCC_FU] = { "fetch buffer", "DQ", "RS" };
+    if (s < OCC_FU) {
+        snprintf(buf, len, "%s", names[s]);
+    } else {
+        snprintf(buf, len, "FU%d", s - OCC_FU);
+    }
+}
+
+/**
+ * Entries the structure holds, 0 for the unbounded DQ.
+ */
+static uint64_t structure_capacity(int s)
+{
+    switch (s) {
+    case OCC_FETCH_BUFFER:
+        return g_f;
+    case OCC_DQ:
+        return 0;
+    case OCC_RS:
+        return g_rs_size;
+    default:
+        return g_fu_classes[s - OCC_FU].count;
+    }
+}
+
+/**
+ * Smallest occupancy at or below which at least fraction p of the cycles fall.
+ */
+static uint64_t percentile(const std::vector<uint64_t>& h, uint64_t cycles, double p)
+{
+    uint64_t target = (uint64_t)(p * cycles + 0.5);
+    uint64_t seen = 0;
+    for (size_t n = 0; n < h.size(); n++) {
+        seen += h[n];
+        if (seen >= target && seen > 0) {
+            return n;
+        }
+    }
+    return h.empty() ? 0 : h.size() - 1;
+}
+
+/**
+ * Mean, percentiles, maximum and the share of cycles spent full for each structure.
+ */
+void print_occupancy(FILE* out)
+{
+    uint64_t cycles = 0;
+    for (size_t n = 0; n < occupancy_hist[OCC_DQ].size(); n++) {
+        cycles += occupancy_hist[OCC_DQ][n];
+    }
+
+    fprintf(out, "Occupancy (%" PRIu64 " cycles):\n", cycles);
+    fprintf(out, "STRUCTURE\tCAPACITY\tMEAN\tP50\tP90\tP99\tMAX\tFULL\n");
+    for (int s = 0; s < num_structures(); s++) {
+        const std::vector<uint64_t>& h = occupancy_hist[s];
+        uint64_t total = 0, sum = 0;
+        for (size_t n = 0; n < h.size(); n++) {
+            total += h[n];
+            sum += n * h[n];
+        }
+
+        char name[32];
+        structure_name(s, name, sizeof(name));
+        uint64_t capacity = structure_capacity(s);
+        fprintf(out, "%s\t", name);
+        if (capacity != 0) {
+            fprintf(out, "%" PRIu64 "\t", capacity);
+        } else {
+            fprintf(out, "-\t");
+        }
+        fprintf(out, "%f\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%zu\t", total ? (double)sum / total : 0.0,
+                percentile(h, total, 0.5), percentile(h, total, 0.9), percentile(h, total, 0.99),
+                h.empty() ? (size_t)0 : h.size() - 1);
+        if (capacity != 0) {
+            uint64_t full = capacity < h.size() ? h[capacity] : 0;
+            fprintf(out, "%.2f%%\n", total ? 100.0 * full / total : 0.0);
+        } else {
+            fprintf(out, "-\n");
+        }
+    }
+}
+
+/**
+ * Writes every histogram bucket as "structure,capacity,occupancy,cycles" rows (- = stdout).
+ */
+bool write_occupancy_csv(const char* path)
+{
+    FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (out == NULL) {
+        perror(path);
+        return false;
+    }
+
+    fprintf(out, "structure,capacity,occupancy,cycles\n");
+    for (int s = 0; s < num_structures(); s++) {
+        char name[32];
+        structure_name(s, name, sizeof(name));
+        const std::vector<uint64_t>& h = occupancy_hist[s];
+        for (size_t n = 0; n < h.size(); n++) {
+            fprintf(out, "%s,%" PRIu64 ",%zu,%" PRIu64 "\n", name, structure_capacity(s), n, h[n]);
+        }
+    }
+
+    if (out == stdout) {
+        fflush(out);
+        return true;
+    }
+    if (fclose(out) != 0) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
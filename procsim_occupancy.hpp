@@ -0,0 +1,41 @@
+#ifndef PROCSIM_OCCUPANCY_HPP
+#define PROCSIM_OCCUPANCY_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "procsim.hpp"
+
+// Structures whose occupancy is recorded every cycle; one FU pool per class follows OCC_FU
+enum occupancy_structure_t
+{
+    OCC_FETCH_BUFFER,
+    OCC_DQ,
+    OCC_RS,
+    OCC_FU,
+    NUM_OCC_HISTS = OCC_FU + MAX_FU_CLASSES
+};
+
+// Record occupancy histograms
+extern bool g_occupancy;
+
+// Cycles spent at each occupancy, indexed by occupancy
+extern std::vector<uint64_t> occupancy_hist[NUM_OCC_HISTS];
+
+void occupancy_reset(void);
+void print_occupancy(FILE* out);
+bool write_occupancy_csv(const char* path);
+
+/**
+ * Counts one cycle at occupancy n; the histogram grows to the largest occupancy seen.
+ */
+static inline void occupancy_record(int structure, uint64_t n)
+{
+    std::vector<uint64_t>& h = occupancy_hist[structure];
+    if (n >= h.size()) {
+        h.resize(n + 1);
+    }
+    h[n]++;
+}
+
+#endif /* PROCSIM_OCCUPANCY_HPP */
@@ -0,0 +1,249 @@
+#include "procsim_report.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <iterator>
+
+//
+// Sweep report: reads sweep rows (config + stats) once, front to back, and keeps only
+// per-trace summaries whose size does not depend on the number of rows:
+//  - the normal equations of a linear fit of IPC on (R, F, k0, k1, k2)
+//  - the IPC vs cost Pareto frontier (at most one point per distinct cost)
+//  - the IPC sum and count for every value of every parameter
+//
+
+#define REPORT_PARAMS 5
+
+static const char* param_names[REPORT_PARAMS] = { "R", "F", "k0", "k1", "k2" };
+
+typedef struct _pareto_point_t
+{
+    double ipc;
+    uint64_t params[REPORT_PARAMS];
+} pareto_point_t;
+
+typedef struct _value_stats_t
+{
+    double ipc_sum;
+    uint64_t count;
+} value_stats_t;
+
+typedef struct _trace_report_t
+{
+    uint64_t rows;
+    double xtx[REPORT_PARAMS + 1][REPORT_PARAMS + 1];  // Column 0 is the intercept
+    double xty[REPORT_PARAMS + 1];
+    std::map<double, pareto_point_t> frontier;         // Keyed by cost, IPC rises with cost
+    std::map<uint64_t, value_stats_t> by_value[REPORT_PARAMS];
+} trace_report_t;
+
+/**
+ * Adds a point to the frontier unless a point that is no more expensive has at least its IPC.
+ */
+static void pareto_insert(std::map<double, pareto_point_t>& frontier, double cost, const pareto_point_t& p)
+{
+    std::map<double, pareto_point_t>::iterator it = frontier.upper_bound(cost);
+    if (it != frontier.begin() && std::prev(it)->second.ipc >= p.ipc) {
+        return;
+    }
+
+    // Drop points that cost at least as much and do not beat the new IPC
+    std::map<double, pareto_point_t>::iterator first = frontier.lower_bound(cost);
+    std::map<double, pareto_point_t>::iterator last = first;
+    while (last != frontier.end() && last->second.ipc <= p.ipc) {
+        ++last;
+    }
+    frontier.erase(first, last);
+    frontier[cost] = p;
+}
+
+/**
+ * Solves the normal equations for the parameters that vary; fixed parameters get NAN.
+ */
+static void fit_sensitivity(const trace_report_t* r, double* slope)
+{
+    int cols[REPORT_PARAMS + 1];
+    int n = 0;
+    cols[n++] = 0;
+    for (int p = 0; p < REPORT_PARAMS; p++) {
+        double mean = r->xtx[0][p + 1] / r->rows;
+        double var = r->xtx[p + 1][p + 1] / r->rows - mean * mean;
+        slope[p] = NAN;
+        if (var > 1e-9) {
+            cols[n++] = p + 1;
+        }
+    }
+
+    double a[REPORT_PARAMS + 1][REPORT_PARAMS + 2];
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i][j] = r->xtx[cols[i]][cols[j]];
+        }
+        a[i][n] = r->xty[cols[i]];
+    }
+
+    // Gaussian elimination with partial pivoting
+    for (int k = 0; k < n; k++) {
+        int pivot = k;
+        for (int i = k + 1; i < n; i++) {
+            if (fabs(a[i][k]) > fabs(a[pivot][k])) {
+                pivot = i;
+            }
+        }
+        if (fabs(a[pivot][k]) < 1e-12) {
+            return;
+        }
+        for (int j = 0; j <= n; j++) {
+            double t = a[k][j];
+            a[k][j] = a[pivot][j];
+            a[pivot][j] = t;
+        }
+        for (int i = 0; i < n; i++) {
+            if (i != k) {
+                double f = a[i][k] / a[k][k];
+                for (int j = k; j <= n; j++) {
+                    a[i][j] -= f * a[k][j];
+                }
+            }
+        }
+    }
+
+    for (int i = 1; i < n; i++) {
+        slope[cols[i] - 1] = a[i][n] / a[i][i];
+    }
+}
+
+static void print_trace_report(FILE* out, const report_options_t* p_opts, const std::string& trace,
+                               const trace_report_t* r)
+{
+    fprintf(out, "Trace: %s (%" PRIu64 " configurations)\n", trace.c_str(), r->rows);
+
+    double slope[REPORT_PARAMS];
+    fit_sensitivity(r, slope);
+    fprintf(out, "Sensitivity (IPC per unit, linear fit):\n");
+    for (int p = 0; p < REPORT_PARAMS; p++) {
+        fprintf(out, "%s%s", p ? "\t" : "", param_names[p]);
+    }
+    fprintf(out, "\n");
+    for (int p = 0; p < REPORT_PARAMS; p++) {
+        if (std::isnan(slope[p])) {
+            fprintf(out, "%sfixed", p ? "\t" : "");
+        } else {
+            fprintf(out, "%s%f", p ? "\t" : "", slope[p]);
+        }
+    }
+    fprintf(out, "\n");
+
+    fprintf(out, "Pareto frontier (cost = %g*(k0+k1+k2) + %g*R):\n", p_opts->cost_fu, p_opts->cost_r);
+    fprintf(out, "cost\tR\tF\tk0\tk1\tk2\tIPC\n");
+    for (std::map<double, pareto_point_t>::const_iterator it = r->frontier.begin(); it != r->frontier.end(); ++it) {
+        const pareto_point_t* p = &it->second;
+        fprintf(out, "%.2f\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%f\n", it->first,
+                p->params[0], p->params[1], p->params[2], p->params[3], p->params[4], p->ipc);
+    }
+
+    fprintf(out, "Diminishing returns (mean IPC per value; knee = first step gaining < %g of the first step):\n",
+            p_opts->knee);
+    for (int p = 0; p < REPORT_PARAMS; p++) {
+        const std::map<uint64_t, value_stats_t>& values = r->by_value[p];
+        fprintf(out, "%s:", param_names[p]);
+
+        double first_gain = NAN;
+        double prev_ipc = NAN;
+        uint64_t prev_value = 0;
+        bool knee_found = false;
+        uint64_t knee = 0;
+        for (std::map<uint64_t, value_stats_t>::const_iterator it = values.begin(); it != values.end(); ++it) {
+            double ipc = it->second.ipc_sum / it->second.count;
+            fprintf(out, " %" PRIu64 "=%.4f", it->first, ipc);
+
+            if (!std::isnan(prev_ipc)) {
+                double gain = (ipc - prev_ipc) / (double)(it->first - prev_value);
+                if (std::isnan(first_gain)) {
+                    first_gain = gain;
+                } else if (!knee_found && gain < p_opts->knee * first_gain) {
+                    knee_found = true;
+                    knee = prev_value;
+                }
+            }
+            prev_ipc = ipc;
+            prev_value = it->first;
+        }
+
+        if (knee_found) {
+            fprintf(out, "  (knee at %" PRIu64 ")", knee);
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Streams a sweep CSV and prints sensitivity, Pareto and diminishing-returns reports per trace.
+ */
+int run_report(const report_options_t* p_opts)
+{
+    FILE* in = strcmp(p_opts->path, "-") == 0 ? stdin : fopen(p_opts->path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", p_opts->path);
+        return 1;
+    }
+
+    std::map<std::string, trace_report_t> traces;
+    char line[8192];
+    char trace[4096];
+    uint64_t skipped = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (strncmp(line, "trace,", 6) == 0) {
+            continue;
+        }
+
+        uint64_t v[REPORT_PARAMS];
+        uint64_t retired, cycles;
+        // Columns: trace,R,k0,k1,k2,F,retired,cycles,...
+        if (sscanf(line, "%4095[^,],%" SCNu64 ",%" SCNu64 ",%" SCNu64 ",%" SCNu64 ",%" SCNu64 ",%" SCNu64 ",%" SCNu64,
+                   trace, &v[0], &v[2], &v[3], &v[4], &v[1], &retired, &cycles) != 8 || cycles == 0) {
+            skipped++;
+            continue;
+        }
+
+        double ipc = (double)retired / (double)cycles;
+        trace_report_t& r = traces[trace];
+        r.rows++;
+
+        double x[REPORT_PARAMS + 1] = { 1.0, (double)v[0], (double)v[1], (double)v[2], (double)v[3], (double)v[4] };
+        for (int i = 0; i <= REPORT_PARAMS; i++) {
+            for (int j = 0; j <= REPORT_PARAMS; j++) {
+                r.xtx[i][j] += x[i] * x[j];
+            }
+            r.xty[i] += x[i] * ipc;
+        }
+
+        pareto_point_t point;
+        point.ipc = ipc;
+        memcpy(point.params, v, sizeof(v));
+        double cost = p_opts->cost_fu * (double)(v[2] + v[3] + v[4]) + p_opts->cost_r * (double)v[0];
+        pareto_insert(r.frontier, cost, point);
+
+        for (int p = 0; p < REPORT_PARAMS; p++) {
+            value_stats_t& vs = r.by_value[p][v[p]];
+            vs.ipc_sum += ipc;
+            vs.count++;
+        }
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (skipped > 0) {
+        fprintf(stderr, "Skipped %" PRIu64 " malformed rows\n", skipped);
+    }
+
+    for (std::map<std::string, trace_report_t>::const_iterator it = traces.begin(); it != traces.end(); ++it) {
+        print_trace_report(stdout, p_opts, it->first, &it->second);
+    }
+    return 0;
+}
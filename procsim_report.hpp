@@ -0,0 +1,16 @@
+#ifndef PROCSIM_REPORT_HPP
+#define PROCSIM_REPORT_HPP
+
+#define DEFAULT_REPORT_KNEE 0.1
+
+typedef struct _report_options_t
+{
+    const char* path;    // Sweep CSV as printed by --serve ("-" = stdin)
+    double cost_fu;      // cost = cost_fu * (k0 + k1 + k2) + cost_r * R
+    double cost_r;
+    double knee;         // A step is past the knee once it gains less than knee * the first step
+} report_options_t;
+
+int run_report(const report_options_t* p_opts);
+
+#endif /* PROCSIM_REPORT_HPP */
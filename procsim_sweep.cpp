@@ -0,0 +1,468 @@
+#include "procsim_sweep.hpp"
+#include "procsim_trace.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <csignal>
+#include <algorithm>
+#include <string>
+#include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+bool g_pin_workers = false;
+
+// CPUs workers may be pinned to, in the order worker slots take them
+static std::vector<int> slot_cpu;
+static std::vector<int> slot_node;
+static std::vector<std::vector<int> > node_cpus;
+
+// Decoded trace replicated once per NUMA node for pinned workers
+static std::string replica_trace;
+static std::vector<proc_inst_t*> replicas;
+static uint64_t replica_count = 0;
+
+int default_worker_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/**
+ * Parses a sysfs cpulist such as "0-3,8-11" and keeps the CPUs that are in `allowed`.
+ */
+static std::vector<int> parse_cpulist(const char* list, const cpu_set_t* allowed)
+{
+    std::vector<int> cpus;
+    const char* p = list;
+    while (*p != '\0' && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p) {
+            break;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long c = first; c <= last && c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, allowed)) {
+                cpus.push_back((int)c);
+            }
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return cpus;
+}
+
+/**
+ * Reads the NUMA nodes from sysfs (one node holding every CPU if there is no NUMA
+ * information) and orders the allowed CPUs so consecutive worker slots alternate nodes.
+ */
+void load_cpu_topology(void)
+{
+    if (!slot_cpu.empty()) {
+        return;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+
+    DIR* dir = opendir("/sys/devices/system/node");
+    struct dirent* ent;
+    while (dir != NULL && (ent = readdir(dir)) != NULL) {
+        int node;
+        if (sscanf(ent->d_name, "node%d", &node) != 1) {
+            continue;
+        }
+        char path[512], list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", ent->d_name);
+        FILE* f = fopen(path, "r");
+        if (f == NULL) {
+            continue;
+        }
+        if (fgets(list, sizeof(list), f) != NULL) {
+            std::vector<int> cpus = parse_cpulist(list, &allowed);
+            if (!cpus.empty()) {
+                node_cpus.push_back(cpus);
+            }
+        }
+        fclose(f);
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+
+    if (node_cpus.empty()) {
+        std::vector<int> cpus;
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed)) {
+                cpus.push_back(c);
+            }
+        }
+        node_cpus.push_back(cpus);
+    }
+
+    for (size_t i = 0; slot_cpu.size() < (size_t)CPU_COUNT(&allowed); i++) {
+        for (size_t n = 0; n < node_cpus.size(); n++) {
+            if (i < node_cpus[n].size()) {
+                slot_cpu.push_back(node_cpus[n][i]);
+                slot_node.push_back((int)n);
+            }
+        }
+    }
+
+    fprintf(stderr, "Pinning workers to %zu CPUs on %zu NUMA nodes\n",
+            slot_cpu.size(), node_cpus.size());
+}
+
+static bool pin_to_cpus(const std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) {
+        CPU_SET(c, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+bool pin_worker(int slot)
+{
+    load_cpu_topology();
+    std::vector<int> cpu(1, slot_cpu[slot % slot_cpu.size()]);
+    return pin_to_cpus(cpu);
+}
+
+/**
+ * Decodes the trace once and copies it into one shared mapping per NUMA node. Each copy
+ * is written by a helper process running on that node, so first-touch places its pages
+ * in the node's local memory. Forked workers read the replica of their own node.
+ */
+static bool load_replicas(const char* trace)
+{
+    if (replica_trace == trace) {
+        return true;
+    }
+    load_cpu_topology();
+
+    FILE* file = fopen(trace, "r");
+    if (file == NULL) {
+        return false;
+    }
+    std::vector<proc_inst_t> insts;
+    trace_decode_all(file, insts);
+
+    for (proc_inst_t* r : replicas) {
+        munmap(r, replica_count * sizeof(proc_inst_t));
+    }
+    replicas.clear();
+    replica_trace.clear();
+    replica_count = insts.size();
+
+    size_t bytes = (insts.empty() ? 1 : insts.size()) * sizeof(proc_inst_t);
+    for (size_t n = 0; n < node_cpus.size(); n++) {
+        void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+        replicas.push_back((proc_inst_t*)p);
+
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            pin_to_cpus(node_cpus[n]);
+            memcpy(p, insts.data(), insts.size() * sizeof(proc_inst_t));
+            _exit(0);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            return false;
+        }
+    }
+
+    replica_trace = trace;
+    return true;
+}
+
+/**
+ * Runs one job inside a freshly forked child and writes its stats to fd.
+ * The engine keeps its state in globals, so every simulation gets its own process.
+ * A pinned child runs on its slot's CPU and reads the trace replica of that CPU's node.
+ */
+static void run_job_child(const char* trace, sweep_job_t* p_job, int fd, int slot)
+{
+    trace_source_t src;
+    if (slot >= 0) {
+        pin_worker(slot);
+        trace_from_memory(&src, replicas[slot_node[slot % slot_node.size()]], replica_count);
+    } else {
+        FILE* file = fopen(trace, "r");
+        if (file == NULL) {
+            _exit(2);
+        }
+        trace_from_file(&src, file);
+    }
+    g_trace = &src;
+
+    g_print_events = false;
+    g_print_progress = false;
+    g_max_insts = p_job->max_insts;
+
+    const sweep_config_t* c = &p_job->config;
+    setup_proc(c->r, c->k0, c->k1, c->k2, c->f);
+
+    proc_stats_t stats;
+    memset(&stats, 0, sizeof(proc_stats_t));
+    run_proc(&stats);
+    complete_proc(&stats);
+
+    if (write(fd, &stats, sizeof(stats)) != (ssize_t)sizeof(stats)) {
+        _exit(3);
+    }
+    _exit(0);
+}
+
+typedef struct _running_job_t
+{
+    pid_t pid;
+    int fd;
+    size_t index;
+    int slot;            // Worker slot the job is pinned to, -1 if unpinned
+} running_job_t;
+
+/**
+ * Kills and reaps the children still running and closes their pipes, so giving up on a
+ * sweep leaves no strays behind.
+ */
+static void abort_running(std::vector<running_job_t>& running)
+{
+    for (size_t i = 0; i < running.size(); i++) {
+        kill(running[i].pid, SIGKILL);
+    }
+    for (size_t i = 0; i < running.size(); i++) {
+        waitpid(running[i].pid, NULL, 0);
+        close(running[i].fd);
+    }
+    running.clear();
+}
+
+/**
+ * Runs all jobs on the given trace, keeping up to `workers` simulations in flight.
+ * Each job's ok flag reports whether its child produced stats.
+ */
+static void run_jobs(const char* trace, std::vector<sweep_job_t>& jobs, int workers, bool pin)
+{
+    if (workers <= 0) {
+        workers = default_worker_count();
+    }
+    if (pin && !load_replicas(trace)) {
+        fprintf(stderr, "Could not replicate %s, running workers unpinned\n", trace);
+        pin = false;
+    }
+
+    std::vector<running_job_t> running;
+    std::vector<bool> slot_busy(workers, false);
+    size_t next = 0;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    while (next < jobs.size() || !running.empty()) {
+        while ((int)running.size() < workers && next < jobs.size()) {
+            sweep_job_t* p_job = &jobs[next];
+            p_job->ok = false;
+
+            int slot = -1;
+            if (pin) {
+                slot = std::find(slot_busy.begin(), slot_busy.end(), false) - slot_busy.begin();
+                slot_busy[slot] = true;
+            }
+
+            int fds[2];
+            if (pipe(fds) != 0) {
+                perror("pipe");
+                abort_running(running);
+                return;
+            }
+
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                close(fds[0]);
+                close(fds[1]);
+                abort_running(running);
+                return;
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                run_job_child(trace, p_job, fds[1], slot);
+            }
+
+            close(fds[1]);
+            running_job_t r = { pid, fds[0], next, slot };
+            running.push_back(r);
+            next++;
+        }
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            perror("waitpid");
+            abort_running(running);
+            return;
+        }
+
+        for (size_t i = 0; i < running.size(); i++) {
+            if (running[i].pid != pid) {
+                continue;
+            }
+            sweep_job_t* p_job = &jobs[running[i].index];
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                ssize_t n = read(running[i].fd, &p_job->stats, sizeof(p_job->stats));
+                p_job->ok = (n == (ssize_t)sizeof(p_job->stats));
+            }
+            close(running[i].fd);
+            if (running[i].slot >= 0) {
+                slot_busy[running[i].slot] = false;
+            }
+            running.erase(running.begin() + i);
+            break;
+        }
+    }
+}
+
+void run_jobs_parallel(const char* trace, std::vector<sweep_job_t>& jobs, int workers)
+{
+    run_jobs(trace, jobs, workers, g_pin_workers);
+}
+
+/**
+ * Runs a single job unpinned; it inherits the caller's CPU affinity.
+ */
+bool run_job(const char* trace, sweep_job_t* p_job)
+{
+    std::vector<sweep_job_t> jobs(1, *p_job);
+    run_jobs(trace, jobs, 1, false);
+    *p_job = jobs[0];
+    return p_job->ok;
+}
+
+double config_cost(const tune_options_t* p_opts, const sweep_config_t* p_cfg)
+{
+    return p_opts->cost_fu * (double)(p_cfg->k0 + p_cfg->k1 + p_cfg->k2) +
+           p_opts->cost_r * (double)p_cfg->r;
+}
+
+/**
+ * Marks each job that is not dominated by another job. A job is dominated when some
+ * other job costs no more and beats its IPC by at least the relative margin.
+ */
+static std::vector<bool> pareto_survivors(const tune_options_t* p_opts,
+                                          const std::vector<sweep_job_t>& jobs, double margin)
+{
+    std::vector<bool> keep(jobs.size(), false);
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (!jobs[i].ok) {
+            continue;
+        }
+        double cost_i = config_cost(p_opts, &jobs[i].config);
+        double ipc_i = jobs[i].stats.avg_inst_retired * (1.0 + margin);
+
+        keep[i] = true;
+        for (size_t j = 0; j < jobs.size(); j++) {
+            if (j == i || !jobs[j].ok) {
+                continue;
+            }
+            double cost_j = config_cost(p_opts, &jobs[j].config);
+            double ipc_j = jobs[j].stats.avg_inst_retired;
+            if (cost_j <= cost_i && ipc_j >= ipc_i && (cost_j < cost_i || ipc_j > ipc_i)) {
+                keep[i] = false;
+                break;
+            }
+        }
+    }
+
+    return keep;
+}
+
+/**
+ * Searches k0, k1, k2 and R for the IPC vs cost Pareto frontier. A short sampled run of
+ * every configuration prunes dominated points; only survivors run the full trace.
+ */
+int run_autotune(const tune_options_t* p_opts)
+{
+    std::vector<sweep_job_t> sampled;
+    for (uint64_t r = 1; r <= p_opts->max_r; r++) {
+        for (uint64_t k0 = 1; k0 <= p_opts->max_fu; k0++) {
+            for (uint64_t k1 = 1; k1 <= p_opts->max_fu; k1++) {
+                for (uint64_t k2 = 1; k2 <= p_opts->max_fu; k2++) {
+                    sweep_job_t job;
+                    memset(&job, 0, sizeof(job));
+                    job.config.r = r;
+                    job.config.k0 = k0;
+                    job.config.k1 = k1;
+                    job.config.k2 = k2;
+                    job.config.f = p_opts->f;
+                    job.max_insts = p_opts->sample;
+                    sampled.push_back(job);
+                }
+            }
+        }
+    }
+
+    fprintf(stderr, "Tuning: sampling %zu configurations (%" PRIu64 " instructions each)\n",
+            sampled.size(), p_opts->sample);
+    run_jobs_parallel(p_opts->trace, sampled, p_opts->workers);
+
+    std::vector<bool> keep = pareto_survivors(p_opts, sampled, p_opts->margin);
+    std::vector<sweep_job_t> full;
+    std::vector<double> sample_ipc;
+    for (size_t i = 0; i < sampled.size(); i++) {
+        if (keep[i]) {
+            sweep_job_t job = sampled[i];
+            job.max_insts = 0;
+            job.ok = false;
+            full.push_back(job);
+            sample_ipc.push_back(sampled[i].stats.avg_inst_retired);
+        }
+    }
+
+    fprintf(stderr, "Tuning: %zu survivors, running full trace\n", full.size());
+    run_jobs_parallel(p_opts->trace, full, p_opts->workers);
+
+    std::vector<bool> frontier = pareto_survivors(p_opts, full, 0.0);
+    std::vector<size_t> order;
+    for (size_t i = 0; i < full.size(); i++) {
+        if (frontier[i]) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return config_cost(p_opts, &full[a].config) < config_cost(p_opts, &full[b].config);
+    });
+
+    printf("Pareto frontier (%zu of %zu configurations, %zu fully simulated)\n",
+           order.size(), sampled.size(), full.size());
+    printf("R\tk0\tk1\tk2\tF\tcost\tsample IPC\tIPC\tcycles\n");
+    for (size_t i : order) {
+        const sweep_job_t* p_job = &full[i];
+        const sweep_config_t* c = &p_job->config;
+        printf("%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.2f\t%f\t%f\t%" PRIu64 "\n",
+               c->r, c->k0, c->k1, c->k2, c->f, config_cost(p_opts, c), sample_ipc[i],
+               p_job->stats.avg_inst_retired, p_job->stats.cycle_count);
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef PROCSIM_SWEEP_HPP
+#define PROCSIM_SWEEP_HPP
+
+#include <cstdint>
+#include <vector>
+#include "procsim.hpp"
+
+#define DEFAULT_TUNE_MAX_FU 4
+#define DEFAULT_TUNE_MAX_R 8
+#define DEFAULT_TUNE_SAMPLE 10000
+#define DEFAULT_TUNE_MARGIN 0.02
+
+typedef struct _sweep_config_t
+{
+    uint64_t r;
+    uint64_t k0;
+    uint64_t k1;
+    uint64_t k2;
+    uint64_t f;
+} sweep_config_t;
+
+typedef struct _sweep_job_t
+{
+    sweep_config_t config;
+    uint64_t max_insts;  // 0 = whole trace
+    proc_stats_t stats;  // Filled in when ok is set
+    bool ok;
+} sweep_job_t;
+
+typedef struct _tune_options_t
+{
+    const char* trace;
+    uint64_t f;
+    uint64_t max_fu;     // Each of k0, k1, k2 is searched over [1, max_fu]
+    uint64_t max_r;      // R is searched over [1, max_r]
+    double cost_fu;      // cost = cost_fu * (k0 + k1 + k2) + cost_r * R
+    double cost_r;
+    uint64_t sample;     // Instructions simulated in the pruning pass
+    double margin;       // Relative IPC slack kept when pruning sampled results
+    int workers;         // Concurrent simulations (0 = one per online core)
+} tune_options_t;
+
+// Pin sweep workers to cores and give them a per-NUMA-node copy of the decoded trace
+extern bool g_pin_workers;
+
+int default_worker_count(void);
+void load_cpu_topology(void);
+bool pin_worker(int slot);
+
+bool run_job(const char* trace, sweep_job_t* p_job);
+void run_jobs_parallel(const char* trace, std::vector<sweep_job_t>& jobs, int workers);
+
+double config_cost(const tune_options_t* p_opts, const sweep_config_t* p_cfg);
+int run_autotune(const tune_options_t* p_opts);
+
+#endif /* PROCSIM_SWEEP_HPP */
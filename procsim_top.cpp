@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <unistd.h>
+#include <sys/types.h>
+#include "procsim_live.hpp"
+
+//
+// procsim-top: periodically prints the counters a running `procsim --live NAME`
+// publishes. Reading never blocks or slows the simulator. It stops when the run
+// finishes, when the simulator process is gone, or when the cycle stops advancing
+// (a simulator killed before it could mark the run finished, or its pid reused).
+//
+
+void print_help_and_exit(void) {
+    printf("procsim-top [OPTIONS]\n");
+    printf("  -n NAME\tShared memory name given to procsim --live (default /procsim)\n");
+    printf("  -d MS\t\tRefresh interval in milliseconds (default 1000)\n");
+    printf("  -1\t\tPrint one sample and exit\n");
+    printf("  -s N\t\tStop after N samples without the cycle advancing (default 10, 0 = never)\n");
+    printf("  -h\t\tThis helpful output\n");
+    exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    const char* name = "/procsim";
+    unsigned delay_ms = 1000;
+    bool once = false;
+    unsigned stall_limit = 10;
+
+    while(-1 != (opt = getopt(argc, argv, "n:d:1s:h"))) {
+        switch(opt) {
+        case 'n':
+            name = optarg;
+            break;
+        case 'd':
+            delay_ms = atoi(optarg);
+            break;
+        case '1':
+            once = true;
+            break;
+        case 's':
+            stall_limit = atoi(optarg);
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+
+    live_stats_t* p_live = open_live_stats(name, false);
+    if (p_live == NULL) {
+        return 1;
+    }
+
+    printf("%12s %12s %8s %8s %8s %10s  %s\n",
+           "cycle", "retired", "IPC", "IPC(int)", "DQ", "RS", "FU busy/count per class");
+
+    live_snapshot_t prev;
+    if (!read_live_stats(p_live, &prev)) {
+        printf("(simulator exited)\n");
+        return 1;
+    }
+    unsigned stalled = 0, sample = 0;
+    for (;;) {
+        live_snapshot_t cur;
+        if (!read_live_stats(p_live, &cur)) {
+            printf("(simulator exited)\n");
+            return 1;
+        }
+        bool gone = !cur.finished && !live_writer_alive(p_live);
+        if (sample++ > 0) {
+            stalled = cur.current_cycle == prev.current_cycle ? stalled + 1 : 0;
+        }
+        bool stuck = !cur.finished && stall_limit != 0 && stalled >= stall_limit;
+
+        double ipc = cur.current_cycle ? (double)cur.total_retired / cur.current_cycle : 0.0;
+        uint64_t dc = cur.current_cycle - prev.current_cycle;
+        double ipc_interval = dc ? (double)(cur.total_retired - prev.total_retired) / dc : 0.0;
+
+        char rs[32];
+        snprintf(rs, sizeof(rs), "%" PRIu64 "/%" PRIu64, cur.rs_size, cur.rs_capacity);
+
+        printf("%12" PRIu64 " %12" PRIu64 " %8.3f %8.3f %8" PRIu64 " %10s ",
+               cur.current_cycle, cur.total_retired, ipc, ipc_interval, cur.dq_size, rs);
+        for (uint64_t i = 0; i < cur.num_fu_classes && i < MAX_FU_CLASSES; i++) {
+            printf(" %" PRIu64 "/%" PRIu64, cur.fu_busy[i], cur.fu_count[i]);
+        }
+        printf("%s\n", cur.finished ? "  (finished)" : gone ? "  (simulator exited)" :
+                        stuck ? "  (no progress)" : "");
+        fflush(stdout);
+
+        if (once || cur.finished) {
+            break;
+        }
+        if (gone || stuck) {
+            return 1;
+        }
+        prev = cur;
+        usleep(delay_ms * 1000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,546 @@
+#include "procsim_trace.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <cctype>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <csignal>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+trace_source_t* g_trace = NULL;
+uint64_t g_trace_threads = 1;
+
+// Read-ahead for text traces; refilled once fewer than TRACE_LINE_MAX bytes are left
+#define TRACE_BUF_SIZE (1 << 20)
+#define TRACE_LINE_MAX 256
+
+// Preloaded traces are mapped in whole huge pages
+#define HUGE_PAGE_SIZE (2 << 20)
+
+// Mapped text traces are parsed in chunks of this many bytes, cut at line starts
+#define TRACE_CHUNK_SIZE (1 << 20)
+
+//
+// Parallel parsing of text trace files (TRACE_MAPPED). The file is mapped and cut into
+// chunks of whole lines. Worker threads claim chunks in file order and decode each into
+// a slot of a ring; chunk c goes to slot c % slots, which frees up once the reader has
+// taken every record of chunk c - slots. trace_read takes the chunks in order, so the
+// stream is the one parse_instruction would produce, as long as records do not span
+// lines. A malformed record ends the trace after the records before it.
+//
+
+// One record as the workers decode it
+typedef struct _trace_record_t
+{
+    uint32_t address;
+    int32_t op_code;
+    int32_t dest_reg;
+    int32_t src_reg[2];
+} trace_record_t;
+
+typedef struct _trace_chunk_t
+{
+    uint64_t index;              // Chunk the records belong to, UINT64_MAX until one is parsed
+    bool malformed;              // Parsing stopped at a malformed record
+    std::vector<trace_record_t> records;
+} trace_chunk_t;
+
+struct _trace_parser_t
+{
+    const char* data;            // Mapped file
+    size_t size;
+    size_t begin;                // Offset of the first unread byte when the file was mapped
+    uint64_t num_chunks;
+
+    std::vector<trace_chunk_t> slots;
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable changed;
+    uint64_t next_claim;         // Next chunk a worker parses
+    uint64_t next_read;          // Chunk the reader takes records from
+    bool stop;                   // Set by trace_close
+
+    // Only touched by the reader
+    size_t read_pos;             // Next record of chunk next_read
+    bool ended;                  // A malformed record ended the trace
+};
+
+void trace_from_file(trace_source_t* src, FILE* file)
+{
+    memset(src, 0, sizeof(*src));
+    src->kind = TRACE_FILE;
+    src->file = file;
+    src->buf = (char*)malloc(TRACE_BUF_SIZE + 1);
+    src->buf[0] = '\0';
+}
+
+void trace_from_memory(trace_source_t* src, const proc_inst_t* insts, uint64_t count)
+{
+    memset(src, 0, sizeof(*src));
+    src->kind = TRACE_MEMORY;
+    src->insts = insts;
+    src->count = count;
+}
+
+void trace_from_synthetic(trace_source_t* src, uint64_t count)
+{
+    memset(src, 0, sizeof(*src));
+    src->kind = TRACE_SYNTHETIC;
+    src->count = count;
+}
+
+/**
+ * Makes src a text trace source, parsed by g_trace_threads workers when the file can be
+ * mapped and on the fetching thread otherwise.
+ */
+void trace_from_text(trace_source_t* src, FILE* file)
+{
+    if (g_trace_threads <= 1 || !trace_from_mapped(src, file, g_trace_threads)) {
+        trace_from_file(src, file);
+    }
+}
+
+/**
+ * Appends every instruction of a text trace to insts and closes the file.
+ */
+void trace_decode_all(FILE* file, std::vector<proc_inst_t>& insts)
+{
+    trace_source_t text;
+    trace_from_text(&text, file);
+
+    size_t got;
+    do {
+        size_t n = insts.size();
+        insts.resize(n + TRACE_BATCH);
+        got = trace_read(&text, &insts[n], TRACE_BATCH);
+        insts.resize(n + got);
+    } while (got > 0);
+    trace_close(&text);
+}
+
+/**
+ * Decodes the whole text trace into one contiguous array and makes src a memory source
+ * over it. The array is backed by explicit huge pages when the system has some reserved,
+ * otherwise by transparent huge pages, and every page is faulted in before returning so
+ * the simulation itself takes no page faults on the trace.
+ */
+bool trace_preload(trace_source_t* src, FILE* file)
+{
+    std::vector<proc_inst_t> insts;
+    trace_decode_all(file, insts);
+
+    size_t bytes = insts.size() * sizeof(proc_inst_t);
+    size_t size = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (size == 0) {
+        size = HUGE_PAGE_SIZE;
+    }
+
+    const char* backing = "hugetlb";
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+#endif
+    if (p == MAP_FAILED) {
+        // Over-allocate and trim so the region starts on a huge page boundary
+        backing = "transparent huge pages";
+        char* raw = (char*)mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+        size_t head = (HUGE_PAGE_SIZE - (uintptr_t)raw % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+        if (head > 0) {
+            munmap(raw, head);
+        }
+        munmap(raw + head + size, HUGE_PAGE_SIZE - head);
+        p = raw + head;
+#ifdef MADV_HUGEPAGE
+        if (madvise(p, size, MADV_HUGEPAGE) != 0) {
+            backing = "4K pages";
+        }
+#else
+        backing = "4K pages";
+#endif
+        // Fault in the tail beyond the copied instructions too
+        memset((char*)p + bytes, 0, size - bytes);
+    }
+    memcpy(p, insts.data(), bytes);
+
+    trace_from_memory(src, (const proc_inst_t*)p, insts.size());
+    src->mapped_size = size;
+
+    fprintf(stderr, "Preloaded %" PRIu64 " instructions (%zu MB, %s)\n",
+            src->count, size >> 20, backing);
+    return true;
+}
+
+void trace_close(trace_source_t* src)
+{
+    if (src->kind == TRACE_MAPPED) {
+        trace_parser_t* tp = src->parser;
+        {
+            std::lock_guard<std::mutex> guard(tp->lock);
+            tp->stop = true;
+        }
+        tp->changed.notify_all();
+        for (size_t i = 0; i < tp->workers.size(); i++) {
+            tp->workers[i].join();
+        }
+        munmap((void*)tp->data, tp->size);
+        delete tp;
+    }
+    if (src->kind == TRACE_FILE || src->kind == TRACE_MAPPED) {
+        if (src->file != NULL && src->file != stdin) {
+            fclose(src->file);
+        }
+        free(src->buf);
+    }
+    if (src->mapped_size != 0) {
+        munmap((void*)src->insts, src->mapped_size);
+    }
+    memset(src, 0, sizeof(*src));
+}
+
+/**
+ * Moves the unparsed tail of the buffer to the front and reads more text after it.
+ */
+static void refill(trace_source_t* src)
+{
+    size_t left = src->buf_len - src->buf_pos;
+    memmove(src->buf, src->buf + src->buf_pos, left);
+    src->buf_len = left;
+    src->buf_pos = 0;
+
+    size_t n = fread(src->buf + left, 1, TRACE_BUF_SIZE - left, src->file);
+    if (n == 0) {
+        src->eof = true;
+    }
+    src->buf_len += n;
+    src->buf[src->buf_len] = '\0';
+}
+
+/**
+ * Parses one "%x %d %d %d %d" record. Anything else ends the trace, as with fscanf.
+ */
+static bool parse_instruction(trace_source_t* src, proc_inst_t* p_inst)
+{
+    if (!src->eof && src->buf_len - src->buf_pos < TRACE_LINE_MAX) {
+        refill(src);
+    }
+
+    char* p = src->buf + src->buf_pos;
+    char* end;
+    p_inst->instruction_address = (uint32_t)strtoul(p, &end, 16);
+    if (end == p) {
+        return false;
+    }
+
+    int32_t* fields[4] = { &p_inst->op_code, &p_inst->dest_reg, &p_inst->src_reg[0], &p_inst->src_reg[1] };
+    for (int i = 0; i < 4; i++) {
+        p = end;
+        *fields[i] = (int32_t)strtol(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+    }
+
+    while (isspace((unsigned char)*end)) {
+        end++;
+    }
+    src->buf_pos = end - src->buf;
+    return true;
+}
+
+static inline const char* skip_space(const char* p, const char* end)
+{
+    while (p < end && isspace((unsigned char)*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline int digit_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return 16;
+}
+
+/**
+ * strtoul/strtol for a field that must end before `end`: leading white space, a sign, and
+ * for base 16 an optional 0x. Returns NULL if there are no digits.
+ */
+static inline const char* parse_number(const char* p, const char* end, int base, uint64_t* p_value)
+{
+    p = skip_space(p, end);
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (base == 16 && end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+        digit_value(p[2]) < 16) {
+        p += 2;
+    }
+
+    const char* start = p;
+    uint64_t value = 0;
+    int d;
+    while (p < end && (d = digit_value(*p)) < base) {
+        value = value * base + d;
+        p++;
+    }
+    if (p == start) {
+        return NULL;
+    }
+    *p_value = negative ? 0 - value : value;
+    return p;
+}
+
+/**
+ * Start of the first line that begins at or after offset `at`.
+ */
+static size_t line_start(const trace_parser_t* tp, size_t at)
+{
+    if (at <= tp->begin) {
+        return tp->begin;
+    }
+    if (at >= tp->size) {
+        return tp->size;
+    }
+    const char* nl = (const char*)memchr(tp->data + at - 1, '\n', tp->size - (at - 1));
+    return nl ? nl + 1 - tp->data : tp->size;
+}
+
+/**
+ * Decodes the records of chunk c into `chunk`.
+ */
+static void parse_chunk(trace_parser_t* tp, uint64_t c, trace_chunk_t* chunk)
+{
+    const char* p = tp->data + line_start(tp, tp->begin + c * TRACE_CHUNK_SIZE);
+    const char* end = tp->data + line_start(tp, tp->begin + (c + 1) * TRACE_CHUNK_SIZE);
+
+    chunk->records.clear();
+    chunk->malformed = false;
+    while ((p = skip_space(p, end)) < end) {
+        trace_record_t r;
+        uint64_t fields[5];
+        for (int i = 0; i < 5 && p != NULL; i++) {
+            p = parse_number(p, end, i == 0 ? 16 : 10, &fields[i]);
+        }
+        if (p == NULL) {
+            chunk->malformed = true;
+            break;
+        }
+        r.address = (uint32_t)fields[0];
+        r.op_code = (int32_t)fields[1];
+        r.dest_reg = (int32_t)fields[2];
+        r.src_reg[0] = (int32_t)fields[3];
+        r.src_reg[1] = (int32_t)fields[4];
+        chunk->records.push_back(r);
+    }
+}
+
+static void parse_worker(trace_parser_t* tp)
+{
+    std::unique_lock<std::mutex> guard(tp->lock);
+    while (!tp->stop && tp->next_claim < tp->num_chunks) {
+        uint64_t c = tp->next_claim++;
+        trace_chunk_t* chunk = &tp->slots[c % tp->slots.size()];
+        tp->changed.wait(guard, [&] { return tp->stop || c < tp->next_read + tp->slots.size(); });
+        if (tp->stop) {
+            break;
+        }
+
+        guard.unlock();
+        parse_chunk(tp, c, chunk);
+        guard.lock();
+        chunk->index = c;
+        tp->changed.notify_all();
+    }
+}
+
+/**
+ * Maps a text trace file and starts `threads` parser threads on it. Returns false, leaving
+ * the file untouched, if it is not a regular file that can be mapped.
+ */
+bool trace_from_mapped(trace_source_t* src, FILE* file, uint64_t threads)
+{
+    int fd = fileno(file);
+    struct stat st;
+    off_t begin = lseek(fd, 0, SEEK_CUR);
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || begin < 0 || begin >= st.st_size) {
+        return false;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    memset(src, 0, sizeof(*src));
+    src->kind = TRACE_MAPPED;
+    src->file = file;
+
+    trace_parser_t* tp = new trace_parser_t();
+    tp->data = (const char*)data;
+    tp->size = st.st_size;
+    tp->begin = begin;
+    tp->num_chunks = (tp->size - tp->begin + TRACE_CHUNK_SIZE - 1) / TRACE_CHUNK_SIZE;
+    threads = std::min<uint64_t>(threads, tp->num_chunks);
+
+    // Two chunks per worker: one being parsed while the other waits for the reader
+    tp->slots.resize(2 * threads);
+    for (size_t i = 0; i < tp->slots.size(); i++) {
+        tp->slots[i].index = UINT64_MAX;
+    }
+    // Workers inherit a blocked signal mask, leaving signals (and the flight recorder
+    // dump) to the simulator thread
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    for (uint64_t i = 0; i < threads; i++) {
+        tp->workers.push_back(std::thread(parse_worker, tp));
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    src->parser = tp;
+    return true;
+}
+
+/**
+ * Takes up to n records of a mapped trace in file order into insts (NULL to drop them).
+ */
+static size_t read_mapped(trace_parser_t* tp, proc_inst_t* insts, size_t n)
+{
+    size_t got = 0;
+    while (got < n && !tp->ended && tp->next_read < tp->num_chunks) {
+        trace_chunk_t* chunk = &tp->slots[tp->next_read % tp->slots.size()];
+        {
+            std::unique_lock<std::mutex> guard(tp->lock);
+            tp->changed.wait(guard, [&] { return chunk->index == tp->next_read; });
+        }
+
+        size_t take = std::min(n - got, chunk->records.size() - tp->read_pos);
+        for (size_t i = 0; insts != NULL && i < take; i++) {
+            const trace_record_t* r = &chunk->records[tp->read_pos + i];
+            proc_inst_t* inst = &insts[got + i];
+            inst->instruction_address = r->address;
+            inst->op_code = r->op_code;
+            inst->dest_reg = r->dest_reg;
+            inst->src_reg[0] = r->src_reg[0];
+            inst->src_reg[1] = r->src_reg[1];
+        }
+        got += take;
+        tp->read_pos += take;
+
+        if (tp->read_pos == chunk->records.size()) {
+            tp->ended = chunk->malformed;
+            tp->read_pos = 0;
+            {
+                std::lock_guard<std::mutex> guard(tp->lock);
+                tp->next_read++;
+            }
+            tp->changed.notify_all();
+        }
+    }
+    return got;
+}
+
+/**
+ * Instruction `index` (0-based) of the synthetic stream: splitmix64 of the index, so any
+ * position can be generated directly. Addresses loop over a 4K instruction footprint
+ * and about one in eight operands is unused.
+ */
+static void synthetic_instruction(uint64_t index, proc_inst_t* p_inst)
+{
+    uint64_t x = (index + 1) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+
+    p_inst->instruction_address = 0x400000 + 4 * (uint32_t)((index + 1) % 4096);
+    p_inst->op_code = (int32_t)(x & 3) - 1;
+    p_inst->dest_reg = ((x >> 8) & 7) ? (int32_t)((x >> 16) % NUM_REGS) : -1;
+    p_inst->src_reg[0] = ((x >> 24) & 7) ? (int32_t)((x >> 32) % NUM_REGS) : -1;
+    p_inst->src_reg[1] = ((x >> 40) & 7) ? (int32_t)((x >> 48) % NUM_REGS) : -1;
+}
+
+/**
+ * Fills insts with up to n instructions and returns how many; 0 means the trace ended.
+ */
+size_t trace_read(trace_source_t* src, proc_inst_t* insts, size_t n)
+{
+    size_t got = 0;
+
+    switch (src->kind) {
+    case TRACE_FILE:
+        while (got < n && parse_instruction(src, &insts[got])) {
+            got++;
+        }
+        break;
+    case TRACE_MAPPED:
+        got = read_mapped(src->parser, insts, n);
+        break;
+    case TRACE_MEMORY:
+        got = src->count - src->next < n ? src->count - src->next : n;
+        memcpy(insts, src->insts + src->next, got * sizeof(proc_inst_t));
+        src->next += got;
+        break;
+    case TRACE_SYNTHETIC:
+        while (got < n && src->next < src->count) {
+            synthetic_instruction(src->next++, &insts[got++]);
+        }
+        break;
+    }
+    return got;
+}
+
+/**
+ * Restarts a memory or synthetic source at its first instruction. Text traces cannot
+ * go back.
+ */
+bool trace_rewind(trace_source_t* src)
+{
+    if (src->kind == TRACE_FILE || src->kind == TRACE_MAPPED) {
+        return false;
+    }
+    src->next = 0;
+    return true;
+}
+
+/**
+ * Drops the next n instructions and returns how many there were.
+ */
+uint64_t trace_skip(trace_source_t* src, uint64_t n)
+{
+    if (src->kind == TRACE_FILE) {
+        proc_inst_t inst;
+        uint64_t skipped = 0;
+        while (skipped < n && parse_instruction(src, &inst)) {
+            skipped++;
+        }
+        return skipped;
+    }
+    if (src->kind == TRACE_MAPPED) {
+        return read_mapped(src->parser, NULL, n);
+    }
+
+    uint64_t skipped = src->count - src->next < n ? src->count - src->next : n;
+    src->next += skipped;
+    return skipped;
+}
@@ -0,0 +1,64 @@
+#ifndef PROCSIM_TRACE_HPP
+#define PROCSIM_TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+#include "procsim.hpp"
+
+// Instructions the fetch stage pulls from the source at once
+#define TRACE_BATCH 4096
+
+typedef enum _trace_kind_t
+{
+    TRACE_FILE,          // Text trace, one "ADDR OPCODE DEST SRC1 SRC2" per line
+    TRACE_MAPPED,        // Text trace file parsed in chunks by worker threads
+    TRACE_MEMORY,        // Caller-owned array of decoded instructions
+    TRACE_SYNTHETIC      // Deterministic generated stream
+} trace_kind_t;
+
+// Where the engine gets its instructions from; all kinds are read the same way
+typedef struct _trace_parser_t trace_parser_t;
+
+typedef struct _trace_source_t
+{
+    trace_kind_t kind;
+
+    // TRACE_FILE and TRACE_MAPPED
+    FILE* file;
+    char* buf;               // Text read ahead of the parser
+    size_t buf_len;
+    size_t buf_pos;
+    bool eof;
+
+    // TRACE_MAPPED
+    trace_parser_t* parser;
+
+    // TRACE_MEMORY and TRACE_SYNTHETIC
+    const proc_inst_t* insts;
+    uint64_t count;          // Instructions in the stream
+    uint64_t next;           // Index of the next instruction returned
+    size_t mapped_size;      // Bytes mapped by trace_preload (0 = insts owned by the caller)
+} trace_source_t;
+
+// Source the fetch stage reads from, set before setup_proc()
+extern trace_source_t* g_trace;
+
+// Parser threads for text trace files (1 = parse on the fetching thread)
+extern uint64_t g_trace_threads;
+
+void trace_from_file(trace_source_t* src, FILE* file);
+bool trace_from_mapped(trace_source_t* src, FILE* file, uint64_t threads);
+void trace_from_text(trace_source_t* src, FILE* file);
+void trace_from_memory(trace_source_t* src, const proc_inst_t* insts, uint64_t count);
+void trace_from_synthetic(trace_source_t* src, uint64_t count);
+bool trace_preload(trace_source_t* src, FILE* file);
+void trace_decode_all(FILE* file, std::vector<proc_inst_t>& insts);
+void trace_close(trace_source_t* src);
+
+size_t trace_read(trace_source_t* src, proc_inst_t* insts, size_t n);
+uint64_t trace_skip(trace_source_t* src, uint64_t n);
+bool trace_rewind(trace_source_t* src);
+
+#endif /* PROCSIM_TRACE_HPP */